@@ -0,0 +1,46 @@
+#  ====================================================================
+#  Copyright (C) 2015 Christopher Gilbert.
+# 
+#  Permission is hereby granted, free of charge, to any person obtaining a copy
+#  of this software and associated documentation files (the "Software"), to deal
+#  in the Software without restriction, including without limitation the rights
+#  to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+#  copies of the Software, and to permit persons to whom the Software is
+#  furnished to do so, subject to the following conditions:
+# 
+#  The above copyright notice and this permission notice shall be included in all
+#  copies or substantial portions of the Software.
+# 
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+#  IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+#  AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+#  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+#  SOFTWARE.
+#  ====================================================================
+
+# Run as a script on every build:
+#   cmake -DSOURCE_DIR=<repo> -DOUTPUT=<header> -P GitRevision.cmake
+# Writes the git describe of SOURCE_DIR into OUTPUT as
+# AHO_CORASICK_GIT_REVISION, touching OUTPUT only when it changes so that
+# an unchanged revision rebuilds nothing.
+
+execute_process(
+	COMMAND git describe --always --dirty
+	WORKING_DIRECTORY ${SOURCE_DIR}
+	OUTPUT_VARIABLE GIT_REVISION
+	OUTPUT_STRIP_TRAILING_WHITESPACE
+	ERROR_QUIET)
+if(NOT GIT_REVISION)
+	set(GIT_REVISION "unknown")
+endif()
+
+set(CONTENT "#define AHO_CORASICK_GIT_REVISION \"${GIT_REVISION}\"\n")
+set(PREVIOUS "")
+if(EXISTS ${OUTPUT})
+	file(READ ${OUTPUT} PREVIOUS)
+endif()
+if(NOT PREVIOUS STREQUAL CONTENT)
+	file(WRITE ${OUTPUT} "${CONTENT}")
+endif()
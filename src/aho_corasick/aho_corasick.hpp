@@ -24,17 +24,84 @@
 #define AHO_CORASICK_HPP
 
 #include <algorithm>
-#include <cctype>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <limits>
 #include <map>
 #include <memory>
+#include <new>
 #include <set>
+#include <stdexcept>
 #include <string>
-#include <queue>
+#include <thread>
+#include <type_traits>
+#include <unordered_set>
 #include <utility>
 #include <vector>
 
+// Defining AHO_CORASICK_INSTRUMENT makes every scan update the calling
+// thread's scan_counters; otherwise the counting compiles away entirely. It
+// changes the bodies of inline functions, so it must be defined alike in
+// every translation unit of a program, through a compile definition on the
+// target rather than a #define before the include. Translation units that
+// disagree on it break the one definition rule, and what gets counted is
+// then unpredictable.
+#ifdef AHO_CORASICK_INSTRUMENT
+#define AHO_CORASICK_COUNT(field, n) (::aho_corasick::thread_scan_counters().field += (n))
+#define AHO_CORASICK_TIME(field) ::aho_corasick::scoped_scan_timer aho_corasick_timer_(::aho_corasick::thread_scan_counters().field)
+#else
+#define AHO_CORASICK_COUNT(field, n) ((void)0)
+#define AHO_CORASICK_TIME(field) ((void)0)
+#endif
+
 namespace aho_corasick {
 
+	// struct scan_counters
+	struct scan_counters {
+		size_t   bytes_scanned = 0;
+		size_t   failure_hops = 0;
+		// steps that left the automaton in the root state
+		size_t   root_visits = 0;
+		// keyword occurrences reached, before whole word filtering
+		size_t   emits = 0;
+		size_t   partial_matches_rejected = 0;
+		size_t   overlaps_removed = 0;
+		uint64_t overlap_nanoseconds = 0;
+
+		double root_dwell() const {
+			return bytes_scanned == 0 ? 0.0 : static_cast<double>(root_visits) / bytes_scanned;
+		}
+
+		void reset() { *this = scan_counters(); }
+	};
+
+	// the counters of scans made on the calling thread, which only move when
+	// AHO_CORASICK_INSTRUMENT is defined
+	inline scan_counters& thread_scan_counters() {
+		static thread_local scan_counters counters;
+		return counters;
+	}
+
+	// class scoped_scan_timer
+	class scoped_scan_timer {
+		uint64_t&                             d_nanoseconds;
+		std::chrono::steady_clock::time_point d_start;
+
+	public:
+		explicit scoped_scan_timer(uint64_t& nanoseconds)
+			: d_nanoseconds(nanoseconds)
+			, d_start(std::chrono::steady_clock::now()) {}
+
+		~scoped_scan_timer() {
+			auto elapsed = std::chrono::steady_clock::now() - d_start;
+			d_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+		}
+	};
+
 	// class interval
 	class interval {
 		size_t d_start;
@@ -70,6 +137,17 @@ namespace aho_corasick {
 		}
 	};
 
+	// orders intervals that share a span by keyword index, where they have one
+	template<typename T>
+	auto keyword_index(const T& i, int) -> decltype(size_t(i.get_index())) {
+		return i.get_index();
+	}
+
+	template<typename T>
+	size_t keyword_index(const T&, long) {
+		return 0;
+	}
+
 	// class interval_tree
 	template<typename T>
 	class interval_tree {
@@ -230,6 +308,175 @@ namespace aho_corasick {
 		}
 	};
 
+	// class flat_interval_tree
+	// an implicit augmented interval tree laid over an array sorted by start:
+	// the node at index i sits at the level given by its trailing one bits,
+	// and d_max_end holds the largest end point in the subtree below it
+	template<typename T>
+	class flat_interval_tree {
+	public:
+		using interval_collection = std::vector<T>;
+		using index_collection    = std::vector<size_t>;
+
+	private:
+		struct frame {
+			int    level;
+			size_t index;
+			bool   visited;
+		};
+
+		interval_collection d_intervals;
+		std::vector<size_t> d_max_end;
+		int                 d_max_level;
+
+	public:
+		explicit flat_interval_tree(interval_collection intervals)
+			: d_intervals(std::move(intervals))
+			, d_max_end(d_intervals.size())
+			, d_max_level(0)
+		{
+			const auto by_start = [](const T& a, const T& b) -> bool {
+				if (a.get_start() != b.get_start()) {
+					return a.get_start() < b.get_start();
+				}
+				if (a.get_end() != b.get_end()) {
+					return a.get_end() < b.get_end();
+				}
+				return keyword_index(a, 0) < keyword_index(b, 0);
+			};
+			if (!std::is_sorted(d_intervals.begin(), d_intervals.end(), by_start)) {
+				std::sort(d_intervals.begin(), d_intervals.end(), by_start);
+			}
+			index();
+		}
+
+		size_t size() const { return d_intervals.size(); }
+		const T& operator[](size_t i) const { return d_intervals[i]; }
+		const interval_collection& get_intervals() const { return d_intervals; }
+
+		// appends the indexes of every interval overlapping i, the interval itself
+		// included, without allocating beyond the caller's buffer
+		void find_overlaps(const interval& i, index_collection& overlaps) const {
+			const size_t n = d_intervals.size();
+			if (n == 0) {
+				return;
+			}
+			frame stack[64];
+			int top = 0;
+			stack[top++] = frame{ d_max_level, (size_t(1) << d_max_level) - 1, false };
+			while (top > 0) {
+				frame f = stack[--top];
+				if (f.level <= 3) {
+					// small subtrees are cheaper to scan than to descend
+					size_t first = f.index >> f.level << f.level;
+					size_t last = std::min(first + (size_t(1) << (f.level + 1)) - 1, n);
+					for (size_t j = first; j < last && d_intervals[j].get_start() <= i.get_end(); ++j) {
+						if (d_intervals[j].get_end() >= i.get_start()) {
+							overlaps.push_back(j);
+						}
+					}
+				} else if (!f.visited) {
+					size_t left = f.index - (size_t(1) << (f.level - 1));
+					stack[top++] = frame{ f.level, f.index, true };
+					if (left >= n || d_max_end[left] >= i.get_start()) {
+						stack[top++] = frame{ f.level - 1, left, false };
+					}
+				} else if (f.index < n && d_intervals[f.index].get_start() <= i.get_end()) {
+					if (d_intervals[f.index].get_end() >= i.get_start()) {
+						overlaps.push_back(f.index);
+					}
+					stack[top++] = frame{ f.level - 1, f.index + (size_t(1) << (f.level - 1)), false };
+				}
+			}
+		}
+
+		// resolves conflicts longest first and then leftmost first, and returns
+		// the survivors ordered by start. Intervals sharing a span, such as a
+		// keyword inserted twice, do not conflict with each other
+		interval_collection remove_overlaps() const {
+			const size_t n = d_intervals.size();
+			index_collection order(n);
+			for (size_t i = 0; i < n; ++i) {
+				order[i] = i;
+			}
+			std::sort(order.begin(), order.end(), [this](size_t a, size_t b) -> bool {
+				const T& x = d_intervals[a];
+				const T& y = d_intervals[b];
+				if (x.size() != y.size()) {
+					return x.size() > y.size();
+				}
+				if (x.get_start() != y.get_start()) {
+					return x.get_start() < y.get_start();
+				}
+				return a < b;
+			});
+			std::vector<bool> removed(n, false);
+			index_collection overlaps;
+			for (auto i : order) {
+				if (removed[i]) {
+					continue;
+				}
+				overlaps.clear();
+				find_overlaps(d_intervals[i], overlaps);
+				for (auto j : overlaps) {
+					if (d_intervals[j] != d_intervals[i]) {
+						removed[j] = true;
+					}
+				}
+			}
+			interval_collection result;
+			for (size_t i = 0; i < n; ++i) {
+				if (!removed[i]) {
+					result.push_back(d_intervals[i]);
+				}
+			}
+			return result;
+		}
+
+	private:
+		void index() {
+			const size_t n = d_intervals.size();
+			if (n == 0) {
+				return;
+			}
+			size_t last_i = 0;
+			size_t last = 0;
+			for (size_t i = 0; i < n; i += 2) {
+				last_i = i;
+				last = d_max_end[i] = d_intervals[i].get_end();
+			}
+			for (size_t i = 1; i < n; i += 2) {
+				d_max_end[i] = d_intervals[i].get_end();
+			}
+			int k = 1;
+			for (; (size_t(1) << k) <= n; ++k) {
+				size_t x = size_t(1) << (k - 1);
+				size_t first = (x << 1) - 1;
+				size_t step = x << 2;
+				for (size_t i = first; i < n; i += step) {
+					size_t left = d_max_end[i - x];
+					size_t right = i + x < n ? d_max_end[i + x] : last;
+					d_max_end[i] = std::max(d_intervals[i].get_end(), std::max(left, right));
+				}
+				last_i = (last_i >> k & 1) ? last_i - x : last_i + x;
+				if (last_i < n && d_max_end[last_i] > last) {
+					last = d_max_end[last_i];
+				}
+			}
+			d_max_level = k - 1;
+		}
+	};
+
+	// resolves the overlaps in a collection of matches or emits in place,
+	// keeping longer and then leftmost ones
+	template<typename T>
+	void resolve_overlaps(std::vector<T>& intervals) {
+		AHO_CORASICK_TIME(overlap_nanoseconds);
+		flat_interval_tree<T> tree(std::move(intervals));
+		intervals = tree.remove_overlaps();
+		AHO_CORASICK_COUNT(overlaps_removed, tree.size() - intervals.size());
+	}
+
 	// class emit
 	template<typename CharType>
 	class emit: public interval {
@@ -240,21 +487,56 @@ namespace aho_corasick {
 	private:
 		string_type d_keyword;
 		unsigned    d_index = 0;
+		size_t      d_code_point_start;
+		size_t      d_code_point_end;
 
 	public:
 		emit()
 			: interval(-1, -1)
-			, d_keyword() {}
+			, d_keyword()
+			, d_code_point_start(-1)
+			, d_code_point_end(-1) {}
 
 		emit(size_t start, size_t end, string_type keyword, unsigned index)
 			: interval(start, end)
-			, d_keyword(keyword), d_index(index) {}
+			, d_keyword(keyword), d_index(index)
+			, d_code_point_start(start)
+			, d_code_point_end(end) {}
+
+		emit(size_t start, size_t end, size_t code_point_start, size_t code_point_end, string_type keyword, unsigned index)
+			: interval(start, end)
+			, d_keyword(keyword), d_index(index)
+			, d_code_point_start(code_point_start)
+			, d_code_point_end(code_point_end) {}
 
 		string_type get_keyword() const { return string_type(d_keyword); }
 		unsigned get_index() const { return d_index; }
+		// code point offsets differ from get_start()/get_end() only when
+		// scanning utf-8
+		size_t get_code_point_start() const { return d_code_point_start; }
+		size_t get_code_point_end() const { return d_code_point_end; }
 		bool is_empty() const { return (get_start() == -1 && get_end() == -1); }
 	};
 
+	// class match
+	// a match that refers to its keyword by index, without copying it
+	class match: public interval {
+		unsigned d_index;
+		size_t   d_code_point_start;
+		size_t   d_code_point_end;
+
+	public:
+		match(size_t start, size_t end, size_t code_point_start, size_t code_point_end, unsigned index)
+			: interval(start, end)
+			, d_index(index)
+			, d_code_point_start(code_point_start)
+			, d_code_point_end(code_point_end) {}
+
+		unsigned get_index() const { return d_index; }
+		size_t get_code_point_start() const { return d_code_point_start; }
+		size_t get_code_point_end() const { return d_code_point_end; }
+	};
+
 	// class token
 	template<typename CharType>
 	class token {
@@ -289,36 +571,518 @@ namespace aho_corasick {
 		emit_type get_emit() const { return d_emit; }
 	};
 
+	namespace unicode {
+
+		// simple case folding (CaseFolding.txt statuses C and S), Unicode 14.0;
+		// code points from first to last, every stride'th, fold to cp + delta
+		struct fold_range {
+			char32_t first;
+			char32_t last;
+			int32_t  delta;
+			unsigned stride;
+		};
+
+		inline const std::vector<fold_range>& fold_ranges() {
+			static const std::vector<fold_range> ranges {
+				{ 0x0041, 0x005a,     32, 1 }, { 0x00b5, 0x00b5,    775, 1 }, { 0x00c0, 0x00d6,     32, 1 },
+				{ 0x00d8, 0x00de,     32, 1 }, { 0x0100, 0x012e,      1, 2 }, { 0x0132, 0x0136,      1, 2 },
+				{ 0x0139, 0x0147,      1, 2 }, { 0x014a, 0x0176,      1, 2 }, { 0x0178, 0x0178,   -121, 1 },
+				{ 0x0179, 0x017d,      1, 2 }, { 0x017f, 0x017f,   -268, 1 }, { 0x0181, 0x0181,    210, 1 },
+				{ 0x0182, 0x0184,      1, 2 }, { 0x0186, 0x0186,    206, 1 }, { 0x0187, 0x0187,      1, 1 },
+				{ 0x0189, 0x018a,    205, 1 }, { 0x018b, 0x018b,      1, 1 }, { 0x018e, 0x018e,     79, 1 },
+				{ 0x018f, 0x018f,    202, 1 }, { 0x0190, 0x0190,    203, 1 }, { 0x0191, 0x0191,      1, 1 },
+				{ 0x0193, 0x0193,    205, 1 }, { 0x0194, 0x0194,    207, 1 }, { 0x0196, 0x0196,    211, 1 },
+				{ 0x0197, 0x0197,    209, 1 }, { 0x0198, 0x0198,      1, 1 }, { 0x019c, 0x019c,    211, 1 },
+				{ 0x019d, 0x019d,    213, 1 }, { 0x019f, 0x019f,    214, 1 }, { 0x01a0, 0x01a4,      1, 2 },
+				{ 0x01a6, 0x01a6,    218, 1 }, { 0x01a7, 0x01a7,      1, 1 }, { 0x01a9, 0x01a9,    218, 1 },
+				{ 0x01ac, 0x01ac,      1, 1 }, { 0x01ae, 0x01ae,    218, 1 }, { 0x01af, 0x01af,      1, 1 },
+				{ 0x01b1, 0x01b2,    217, 1 }, { 0x01b3, 0x01b5,      1, 2 }, { 0x01b7, 0x01b7,    219, 1 },
+				{ 0x01b8, 0x01b8,      1, 1 }, { 0x01bc, 0x01bc,      1, 1 }, { 0x01c4, 0x01c4,      2, 1 },
+				{ 0x01c5, 0x01c5,      1, 1 }, { 0x01c7, 0x01c7,      2, 1 }, { 0x01c8, 0x01c8,      1, 1 },
+				{ 0x01ca, 0x01ca,      2, 1 }, { 0x01cb, 0x01db,      1, 2 }, { 0x01de, 0x01ee,      1, 2 },
+				{ 0x01f1, 0x01f1,      2, 1 }, { 0x01f2, 0x01f4,      1, 2 }, { 0x01f6, 0x01f6,    -97, 1 },
+				{ 0x01f7, 0x01f7,    -56, 1 }, { 0x01f8, 0x021e,      1, 2 }, { 0x0220, 0x0220,   -130, 1 },
+				{ 0x0222, 0x0232,      1, 2 }, { 0x023a, 0x023a,  10795, 1 }, { 0x023b, 0x023b,      1, 1 },
+				{ 0x023d, 0x023d,   -163, 1 }, { 0x023e, 0x023e,  10792, 1 }, { 0x0241, 0x0241,      1, 1 },
+				{ 0x0243, 0x0243,   -195, 1 }, { 0x0244, 0x0244,     69, 1 }, { 0x0245, 0x0245,     71, 1 },
+				{ 0x0246, 0x024e,      1, 2 }, { 0x0345, 0x0345,    116, 1 }, { 0x0370, 0x0372,      1, 2 },
+				{ 0x0376, 0x0376,      1, 1 }, { 0x037f, 0x037f,    116, 1 }, { 0x0386, 0x0386,     38, 1 },
+				{ 0x0388, 0x038a,     37, 1 }, { 0x038c, 0x038c,     64, 1 }, { 0x038e, 0x038f,     63, 1 },
+				{ 0x0391, 0x03a1,     32, 1 }, { 0x03a3, 0x03ab,     32, 1 }, { 0x03c2, 0x03c2,      1, 1 },
+				{ 0x03cf, 0x03cf,      8, 1 }, { 0x03d0, 0x03d0,    -30, 1 }, { 0x03d1, 0x03d1,    -25, 1 },
+				{ 0x03d5, 0x03d5,    -15, 1 }, { 0x03d6, 0x03d6,    -22, 1 }, { 0x03d8, 0x03ee,      1, 2 },
+				{ 0x03f0, 0x03f0,    -54, 1 }, { 0x03f1, 0x03f1,    -48, 1 }, { 0x03f4, 0x03f4,    -60, 1 },
+				{ 0x03f5, 0x03f5,    -64, 1 }, { 0x03f7, 0x03f7,      1, 1 }, { 0x03f9, 0x03f9,     -7, 1 },
+				{ 0x03fa, 0x03fa,      1, 1 }, { 0x03fd, 0x03ff,   -130, 1 }, { 0x0400, 0x040f,     80, 1 },
+				{ 0x0410, 0x042f,     32, 1 }, { 0x0460, 0x0480,      1, 2 }, { 0x048a, 0x04be,      1, 2 },
+				{ 0x04c0, 0x04c0,     15, 1 }, { 0x04c1, 0x04cd,      1, 2 }, { 0x04d0, 0x052e,      1, 2 },
+				{ 0x0531, 0x0556,     48, 1 }, { 0x10a0, 0x10c5,   7264, 1 }, { 0x10c7, 0x10c7,   7264, 1 },
+				{ 0x10cd, 0x10cd,   7264, 1 }, { 0x13f8, 0x13fd,     -8, 1 }, { 0x1c80, 0x1c80,  -6222, 1 },
+				{ 0x1c81, 0x1c81,  -6221, 1 }, { 0x1c82, 0x1c82,  -6212, 1 }, { 0x1c83, 0x1c84,  -6210, 1 },
+				{ 0x1c85, 0x1c85,  -6211, 1 }, { 0x1c86, 0x1c86,  -6204, 1 }, { 0x1c87, 0x1c87,  -6180, 1 },
+				{ 0x1c88, 0x1c88,  35267, 1 }, { 0x1c90, 0x1cba,  -3008, 1 }, { 0x1cbd, 0x1cbf,  -3008, 1 },
+				{ 0x1e00, 0x1e94,      1, 2 }, { 0x1e9b, 0x1e9b,    -58, 1 }, { 0x1e9e, 0x1e9e,  -7615, 1 },
+				{ 0x1ea0, 0x1efe,      1, 2 }, { 0x1f08, 0x1f0f,     -8, 1 }, { 0x1f18, 0x1f1d,     -8, 1 },
+				{ 0x1f28, 0x1f2f,     -8, 1 }, { 0x1f38, 0x1f3f,     -8, 1 }, { 0x1f48, 0x1f4d,     -8, 1 },
+				{ 0x1f59, 0x1f5f,     -8, 2 }, { 0x1f68, 0x1f6f,     -8, 1 }, { 0x1f88, 0x1f8f,     -8, 1 },
+				{ 0x1f98, 0x1f9f,     -8, 1 }, { 0x1fa8, 0x1faf,     -8, 1 }, { 0x1fb8, 0x1fb9,     -8, 1 },
+				{ 0x1fba, 0x1fbb,    -74, 1 }, { 0x1fbc, 0x1fbc,     -9, 1 }, { 0x1fbe, 0x1fbe,  -7173, 1 },
+				{ 0x1fc8, 0x1fcb,    -86, 1 }, { 0x1fcc, 0x1fcc,     -9, 1 }, { 0x1fd8, 0x1fd9,     -8, 1 },
+				{ 0x1fda, 0x1fdb,   -100, 1 }, { 0x1fe8, 0x1fe9,     -8, 1 }, { 0x1fea, 0x1feb,   -112, 1 },
+				{ 0x1fec, 0x1fec,     -7, 1 }, { 0x1ff8, 0x1ff9,   -128, 1 }, { 0x1ffa, 0x1ffb,   -126, 1 },
+				{ 0x1ffc, 0x1ffc,     -9, 1 }, { 0x2126, 0x2126,  -7517, 1 }, { 0x212a, 0x212a,  -8383, 1 },
+				{ 0x212b, 0x212b,  -8262, 1 }, { 0x2132, 0x2132,     28, 1 }, { 0x2160, 0x216f,     16, 1 },
+				{ 0x2183, 0x2183,      1, 1 }, { 0x24b6, 0x24cf,     26, 1 }, { 0x2c00, 0x2c2f,     48, 1 },
+				{ 0x2c60, 0x2c60,      1, 1 }, { 0x2c62, 0x2c62, -10743, 1 }, { 0x2c63, 0x2c63,  -3814, 1 },
+				{ 0x2c64, 0x2c64, -10727, 1 }, { 0x2c67, 0x2c6b,      1, 2 }, { 0x2c6d, 0x2c6d, -10780, 1 },
+				{ 0x2c6e, 0x2c6e, -10749, 1 }, { 0x2c6f, 0x2c6f, -10783, 1 }, { 0x2c70, 0x2c70, -10782, 1 },
+				{ 0x2c72, 0x2c72,      1, 1 }, { 0x2c75, 0x2c75,      1, 1 }, { 0x2c7e, 0x2c7f, -10815, 1 },
+				{ 0x2c80, 0x2ce2,      1, 2 }, { 0x2ceb, 0x2ced,      1, 2 }, { 0x2cf2, 0x2cf2,      1, 1 },
+				{ 0xa640, 0xa66c,      1, 2 }, { 0xa680, 0xa69a,      1, 2 }, { 0xa722, 0xa72e,      1, 2 },
+				{ 0xa732, 0xa76e,      1, 2 }, { 0xa779, 0xa77b,      1, 2 }, { 0xa77d, 0xa77d, -35332, 1 },
+				{ 0xa77e, 0xa786,      1, 2 }, { 0xa78b, 0xa78b,      1, 1 }, { 0xa78d, 0xa78d, -42280, 1 },
+				{ 0xa790, 0xa792,      1, 2 }, { 0xa796, 0xa7a8,      1, 2 }, { 0xa7aa, 0xa7aa, -42308, 1 },
+				{ 0xa7ab, 0xa7ab, -42319, 1 }, { 0xa7ac, 0xa7ac, -42315, 1 }, { 0xa7ad, 0xa7ad, -42305, 1 },
+				{ 0xa7ae, 0xa7ae, -42308, 1 }, { 0xa7b0, 0xa7b0, -42258, 1 }, { 0xa7b1, 0xa7b1, -42282, 1 },
+				{ 0xa7b2, 0xa7b2, -42261, 1 }, { 0xa7b3, 0xa7b3,    928, 1 }, { 0xa7b4, 0xa7c2,      1, 2 },
+				{ 0xa7c4, 0xa7c4,    -48, 1 }, { 0xa7c5, 0xa7c5, -42307, 1 }, { 0xa7c6, 0xa7c6, -35384, 1 },
+				{ 0xa7c7, 0xa7c9,      1, 2 }, { 0xa7d0, 0xa7d0,      1, 1 }, { 0xa7d6, 0xa7d8,      1, 2 },
+				{ 0xa7f5, 0xa7f5,      1, 1 }, { 0xab70, 0xabbf, -38864, 1 }, { 0xff21, 0xff3a,     32, 1 },
+				{ 0x10400, 0x10427,     40, 1 }, { 0x104b0, 0x104d3,     40, 1 }, { 0x10570, 0x1057a,     39, 1 },
+				{ 0x1057c, 0x1058a,     39, 1 }, { 0x1058c, 0x10592,     39, 1 }, { 0x10594, 0x10595,     39, 1 },
+				{ 0x10c80, 0x10cb2,     64, 1 }, { 0x118a0, 0x118bf,     32, 1 }, { 0x16e40, 0x16e5f,     32, 1 },
+				{ 0x1e900, 0x1e921,     34, 1 },
+			};
+			return ranges;
+		}
+
+		// class fold_table
+		class fold_table {
+			typedef std::array<int32_t, 256> page_type;
+
+			std::vector<unsigned char> d_index;
+			std::vector<page_type>     d_pages;
+
+		public:
+			static const char32_t max_code_point = 0x10ffff;
+
+			fold_table()
+				: d_index((max_code_point >> 8) + 1, 0)
+				, d_pages(1, page_type())
+			{
+				for (const auto& r : fold_ranges()) {
+					for (char32_t c = r.first; c <= r.last; c += r.stride) {
+						auto& page = d_index[c >> 8];
+						if (page == 0) {
+							page = static_cast<unsigned char>(d_pages.size());
+							d_pages.push_back(page_type());
+						}
+						d_pages[page][c & 0xff] = r.delta;
+					}
+				}
+			}
+
+			static const fold_table& instance() {
+				static const fold_table table;
+				return table;
+			}
+
+			char32_t operator()(char32_t c) const {
+				if (c > max_code_point) {
+					return c;
+				}
+				return static_cast<char32_t>(c + d_pages[d_index[c >> 8]][c & 0xff]);
+			}
+		};
+
+		inline char32_t fold(char32_t c) {
+			return fold_table::instance()(c);
+		}
+
+		// letters and combining marks (general categories L and M), Unicode
+		// 14.0; unassigned code points are folded into the surrounding ranges
+		inline bool is_letter(char32_t c) {
+			static const std::pair<char32_t, char32_t> ranges[] = {
+				{ 0x00aa, 0x00aa }, { 0x00b5, 0x00b5 }, { 0x00ba, 0x00ba }, { 0x00c0, 0x00d6 }, { 0x00d8, 0x00f6 },
+				{ 0x00f8, 0x02c1 }, { 0x02c6, 0x02d1 }, { 0x02e0, 0x02e4 }, { 0x02ec, 0x02ec }, { 0x02ee, 0x02ee },
+				{ 0x0300, 0x0374 }, { 0x0376, 0x037d }, { 0x037f, 0x037f }, { 0x0386, 0x0386 }, { 0x0388, 0x03f5 },
+				{ 0x03f7, 0x0481 }, { 0x0483, 0x0559 }, { 0x0560, 0x0588 }, { 0x0591, 0x05bd }, { 0x05bf, 0x05bf },
+				{ 0x05c1, 0x05c2 }, { 0x05c4, 0x05c5 }, { 0x05c7, 0x05f2 }, { 0x0610, 0x061a }, { 0x0620, 0x065f },
+				{ 0x066e, 0x06d3 }, { 0x06d5, 0x06dc }, { 0x06df, 0x06e8 }, { 0x06ea, 0x06ef }, { 0x06fa, 0x06fc },
+				{ 0x06ff, 0x06ff }, { 0x0710, 0x07b1 }, { 0x07ca, 0x07f5 }, { 0x07fa, 0x07fd }, { 0x0800, 0x082d },
+				{ 0x0840, 0x085b }, { 0x0860, 0x0887 }, { 0x0889, 0x088e }, { 0x0898, 0x08e1 }, { 0x08e3, 0x0963 },
+				{ 0x0971, 0x09e3 }, { 0x09f0, 0x09f1 }, { 0x09fc, 0x09fc }, { 0x09fe, 0x0a5e }, { 0x0a70, 0x0a75 },
+				{ 0x0a81, 0x0ae3 }, { 0x0af9, 0x0b63 }, { 0x0b71, 0x0b71 }, { 0x0b82, 0x0bd7 }, { 0x0c00, 0x0c63 },
+				{ 0x0c80, 0x0c83 }, { 0x0c85, 0x0ce3 }, { 0x0cf1, 0x0d4e }, { 0x0d54, 0x0d57 }, { 0x0d5f, 0x0d63 },
+				{ 0x0d7a, 0x0ddf }, { 0x0df2, 0x0df3 }, { 0x0e01, 0x0e3a }, { 0x0e40, 0x0e4e }, { 0x0e81, 0x0ecd },
+				{ 0x0edc, 0x0f00 }, { 0x0f18, 0x0f19 }, { 0x0f35, 0x0f35 }, { 0x0f37, 0x0f37 }, { 0x0f39, 0x0f39 },
+				{ 0x0f3e, 0x0f84 }, { 0x0f86, 0x0fbc }, { 0x0fc6, 0x0fc6 }, { 0x1000, 0x103f }, { 0x1050, 0x108f },
+				{ 0x109a, 0x109d }, { 0x10a0, 0x10fa }, { 0x10fc, 0x135f }, { 0x1380, 0x138f }, { 0x13a0, 0x13fd },
+				{ 0x1401, 0x166c }, { 0x166f, 0x167f }, { 0x1681, 0x169a }, { 0x16a0, 0x16ea }, { 0x16f1, 0x1734 },
+				{ 0x1740, 0x17d3 }, { 0x17d7, 0x17d7 }, { 0x17dc, 0x17dd }, { 0x180b, 0x180d }, { 0x180f, 0x180f },
+				{ 0x1820, 0x193b }, { 0x1950, 0x19c9 }, { 0x1a00, 0x1a1b }, { 0x1a20, 0x1a7f }, { 0x1aa7, 0x1aa7 },
+				{ 0x1ab0, 0x1b4c }, { 0x1b6b, 0x1b73 }, { 0x1b80, 0x1baf }, { 0x1bba, 0x1bf3 }, { 0x1c00, 0x1c37 },
+				{ 0x1c4d, 0x1c4f }, { 0x1c5a, 0x1c7d }, { 0x1c80, 0x1cbf }, { 0x1cd0, 0x1cd2 }, { 0x1cd4, 0x1fbc },
+				{ 0x1fbe, 0x1fbe }, { 0x1fc2, 0x1fcc }, { 0x1fd0, 0x1fdb }, { 0x1fe0, 0x1fec }, { 0x1ff2, 0x1ffc },
+				{ 0x2071, 0x2071 }, { 0x207f, 0x207f }, { 0x2090, 0x209c }, { 0x20d0, 0x20f0 }, { 0x2102, 0x2102 },
+				{ 0x2107, 0x2107 }, { 0x210a, 0x2113 }, { 0x2115, 0x2115 }, { 0x2119, 0x211d }, { 0x2124, 0x2124 },
+				{ 0x2126, 0x2126 }, { 0x2128, 0x2128 }, { 0x212a, 0x212d }, { 0x212f, 0x2139 }, { 0x213c, 0x213f },
+				{ 0x2145, 0x2149 }, { 0x214e, 0x214e }, { 0x2183, 0x2184 }, { 0x2c00, 0x2ce4 }, { 0x2ceb, 0x2cf3 },
+				{ 0x2d00, 0x2d6f }, { 0x2d7f, 0x2dff }, { 0x2e2f, 0x2e2f }, { 0x3005, 0x3006 }, { 0x302a, 0x302f },
+				{ 0x3031, 0x3035 }, { 0x303b, 0x303c }, { 0x3041, 0x309a }, { 0x309d, 0x309f }, { 0x30a1, 0x30fa },
+				{ 0x30fc, 0x318e }, { 0x31a0, 0x31bf }, { 0x31f0, 0x31ff }, { 0x3400, 0x4dbf }, { 0x4e00, 0xa48c },
+				{ 0xa4d0, 0xa4fd }, { 0xa500, 0xa60c }, { 0xa610, 0xa61f }, { 0xa62a, 0xa672 }, { 0xa674, 0xa67d },
+				{ 0xa67f, 0xa6e5 }, { 0xa6f0, 0xa6f1 }, { 0xa717, 0xa71f }, { 0xa722, 0xa788 }, { 0xa78b, 0xa827 },
+				{ 0xa82c, 0xa82c }, { 0xa840, 0xa873 }, { 0xa880, 0xa8c5 }, { 0xa8e0, 0xa8f7 }, { 0xa8fb, 0xa8fb },
+				{ 0xa8fd, 0xa8ff }, { 0xa90a, 0xa92d }, { 0xa930, 0xa953 }, { 0xa960, 0xa9c0 }, { 0xa9cf, 0xa9cf },
+				{ 0xa9e0, 0xa9ef }, { 0xa9fa, 0xaa4d }, { 0xaa60, 0xaa76 }, { 0xaa7a, 0xaadd }, { 0xaae0, 0xaaef },
+				{ 0xaaf2, 0xab5a }, { 0xab5c, 0xab69 }, { 0xab70, 0xabea }, { 0xabec, 0xabed }, { 0xac00, 0xd7fb },
+				{ 0xf900, 0xfb28 }, { 0xfb2a, 0xfbb1 }, { 0xfbd3, 0xfd3d }, { 0xfd50, 0xfdc7 }, { 0xfdf0, 0xfdfb },
+				{ 0xfe00, 0xfe0f }, { 0xfe20, 0xfe2f }, { 0xfe70, 0xfefc }, { 0xff21, 0xff3a }, { 0xff41, 0xff5a },
+				{ 0xff66, 0xffdc }, { 0x10000, 0x100fa }, { 0x101fd, 0x102e0 }, { 0x10300, 0x1031f }, { 0x1032d, 0x10340 },
+				{ 0x10342, 0x10349 }, { 0x10350, 0x1039d }, { 0x103a0, 0x103cf }, { 0x10400, 0x1049d }, { 0x104b0, 0x10563 },
+				{ 0x10570, 0x10855 }, { 0x10860, 0x10876 }, { 0x10880, 0x1089e }, { 0x108e0, 0x108f5 }, { 0x10900, 0x10915 },
+				{ 0x10920, 0x10939 }, { 0x10980, 0x109b7 }, { 0x109be, 0x109bf }, { 0x10a00, 0x10a3f }, { 0x10a60, 0x10a7c },
+				{ 0x10a80, 0x10a9c }, { 0x10ac0, 0x10ac7 }, { 0x10ac9, 0x10ae6 }, { 0x10b00, 0x10b35 }, { 0x10b40, 0x10b55 },
+				{ 0x10b60, 0x10b72 }, { 0x10b80, 0x10b91 }, { 0x10c00, 0x10cf2 }, { 0x10d00, 0x10d27 }, { 0x10e80, 0x10eac },
+				{ 0x10eb0, 0x10f1c }, { 0x10f27, 0x10f50 }, { 0x10f70, 0x10f85 }, { 0x10fb0, 0x10fc4 }, { 0x10fe0, 0x11046 },
+				{ 0x11070, 0x110ba }, { 0x110c2, 0x110c2 }, { 0x110d0, 0x110e8 }, { 0x11100, 0x11134 }, { 0x11144, 0x11173 },
+				{ 0x11176, 0x111c4 }, { 0x111c9, 0x111cc }, { 0x111ce, 0x111cf }, { 0x111da, 0x111da }, { 0x111dc, 0x111dc },
+				{ 0x11200, 0x11237 }, { 0x1123e, 0x112a8 }, { 0x112b0, 0x112ea }, { 0x11300, 0x1144a }, { 0x1145e, 0x114c5 },
+				{ 0x114c7, 0x114c7 }, { 0x11580, 0x115c0 }, { 0x115d8, 0x11640 }, { 0x11644, 0x11644 }, { 0x11680, 0x116b8 },
+				{ 0x11700, 0x1172b }, { 0x11740, 0x1183a }, { 0x118a0, 0x118df }, { 0x118ff, 0x11943 }, { 0x119a0, 0x119e1 },
+				{ 0x119e3, 0x11a3e }, { 0x11a47, 0x11a99 }, { 0x11a9d, 0x11a9d }, { 0x11ab0, 0x11c40 }, { 0x11c72, 0x11d47 },
+				{ 0x11d60, 0x11d98 }, { 0x11ee0, 0x11ef6 }, { 0x11fb0, 0x11fb0 }, { 0x12000, 0x12399 }, { 0x12480, 0x12ff0 },
+				{ 0x13000, 0x1342e }, { 0x14400, 0x16a5e }, { 0x16a70, 0x16abe }, { 0x16ad0, 0x16af4 }, { 0x16b00, 0x16b36 },
+				{ 0x16b40, 0x16b43 }, { 0x16b63, 0x16e7f }, { 0x16f00, 0x16fe1 }, { 0x16fe3, 0x1bc99 }, { 0x1bc9d, 0x1bc9e },
+				{ 0x1cf00, 0x1cf46 }, { 0x1d165, 0x1d169 }, { 0x1d16d, 0x1d172 }, { 0x1d17b, 0x1d182 }, { 0x1d185, 0x1d18b },
+				{ 0x1d1aa, 0x1d1ad }, { 0x1d242, 0x1d244 }, { 0x1d400, 0x1d6c0 }, { 0x1d6c2, 0x1d6da }, { 0x1d6dc, 0x1d6fa },
+				{ 0x1d6fc, 0x1d714 }, { 0x1d716, 0x1d734 }, { 0x1d736, 0x1d74e }, { 0x1d750, 0x1d76e }, { 0x1d770, 0x1d788 },
+				{ 0x1d78a, 0x1d7a8 }, { 0x1d7aa, 0x1d7c2 }, { 0x1d7c4, 0x1d7cb }, { 0x1da00, 0x1da36 }, { 0x1da3b, 0x1da6c },
+				{ 0x1da75, 0x1da75 }, { 0x1da84, 0x1da84 }, { 0x1da9b, 0x1e13d }, { 0x1e14e, 0x1e14e }, { 0x1e290, 0x1e2ef },
+				{ 0x1e7e0, 0x1e8c4 }, { 0x1e8d0, 0x1e94b }, { 0x1ee00, 0x1eebb }, { 0x20000, 0x3134a }, { 0xe0100, 0xe01ef },
+			};
+			if (c < 0x80) {
+				return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+			}
+			auto last = std::end(ranges);
+			auto found = std::upper_bound(std::begin(ranges), last, c, [](char32_t cp, const std::pair<char32_t, char32_t>& r) -> bool {
+				return cp < r.first;
+			});
+			return found != std::begin(ranges) && c <= (found - 1)->second;
+		}
+
+		template<typename CharType>
+		bool is_continuation(CharType c) {
+			return (static_cast<unsigned char>(c) & 0xc0) == 0x80;
+		}
+
+		// returns the length of the sequence, or 0 if it is not valid utf-8
+		template<typename CharType>
+		size_t utf8_decode(const CharType* first, const CharType* last, char32_t& cp) {
+			auto lead = static_cast<unsigned char>(*first);
+			size_t len = 0;
+			if (lead < 0x80) {
+				cp = lead;
+				return 1;
+			} else if (lead >= 0xc2 && lead <= 0xdf) {
+				cp = lead & 0x1f;
+				len = 2;
+			} else if (lead >= 0xe0 && lead <= 0xef) {
+				cp = lead & 0x0f;
+				len = 3;
+			} else if (lead >= 0xf0 && lead <= 0xf4) {
+				cp = lead & 0x07;
+				len = 4;
+			} else {
+				return 0;
+			}
+			if (static_cast<size_t>(last - first) < len) {
+				return 0;
+			}
+			for (size_t i = 1; i < len; ++i) {
+				auto cont = static_cast<unsigned char>(first[i]);
+				if ((cont & 0xc0) != 0x80) {
+					return 0;
+				}
+				cp = (cp << 6) | (cont & 0x3f);
+			}
+			return len;
+		}
+
+		// returns the number of code units written, at most four
+		template<typename CharType>
+		size_t utf8_encode(char32_t cp, CharType* out) {
+			if (cp < 0x80) {
+				out[0] = static_cast<CharType>(cp);
+				return 1;
+			} else if (cp < 0x800) {
+				out[0] = static_cast<CharType>(0xc0 | (cp >> 6));
+				out[1] = static_cast<CharType>(0x80 | (cp & 0x3f));
+				return 2;
+			} else if (cp < 0x10000) {
+				out[0] = static_cast<CharType>(0xe0 | (cp >> 12));
+				out[1] = static_cast<CharType>(0x80 | ((cp >> 6) & 0x3f));
+				out[2] = static_cast<CharType>(0x80 | (cp & 0x3f));
+				return 3;
+			}
+			out[0] = static_cast<CharType>(0xf0 | (cp >> 18));
+			out[1] = static_cast<CharType>(0x80 | ((cp >> 12) & 0x3f));
+			out[2] = static_cast<CharType>(0x80 | ((cp >> 6) & 0x3f));
+			out[3] = static_cast<CharType>(0x80 | (cp & 0x3f));
+			return 4;
+		}
+
+	} // namespace unicode
+
+	// class token_view
+	// a token that points into the tokenised text rather than owning a copy,
+	// so it is only valid for as long as that text
+	template<typename CharType>
+	class token_view {
+	public:
+		using string_type = std::basic_string<CharType>;
+		using token_type  = typename token<CharType>::token_type;
+
+	private:
+		token_type      d_type;
+		const CharType* d_text;
+		size_t          d_start;
+		size_t          d_length;
+		unsigned        d_index;
+
+	public:
+		token_view(const CharType* text, size_t start, size_t length)
+			: d_type(token<CharType>::TYPE_FRAGMENT)
+			, d_text(text)
+			, d_start(start)
+			, d_length(length)
+			, d_index(-1) {}
+
+		token_view(const CharType* text, const match& m)
+			: d_type(token<CharType>::TYPE_MATCH)
+			, d_text(text)
+			, d_start(m.get_start())
+			, d_length(m.size())
+			, d_index(m.get_index()) {}
+
+		bool is_match() const { return (d_type == token<CharType>::TYPE_MATCH); }
+		size_t get_start() const { return d_start; }
+		size_t size() const { return d_length; }
+		const CharType* data() const { return d_text + d_start; }
+		// the keyword index of a match
+		unsigned get_index() const { return d_index; }
+		string_type get_fragment() const { return string_type(data(), size()); }
+	};
+
+	// class case_folding
+	// narrow strings are taken to be utf-8, wider strings to hold one code
+	// point per code unit
+	template<typename CharType>
+	class case_folding {
+	public:
+		typedef std::basic_string<CharType> string_type;
+
+		static const bool is_utf8 = sizeof(CharType) == 1;
+		static const size_t max_sequence_length = 4;
+
+	private:
+		typedef typename std::make_unsigned<CharType>::type unsigned_char_type;
+
+		std::array<CharType, 256> d_table;
+		const unicode::fold_table* d_unicode;
+
+	public:
+		case_folding()
+			: d_table()
+			, d_unicode(&unicode::fold_table::instance())
+		{
+			for (unsigned c = 0; c < d_table.size(); ++c) {
+				d_table[c] = static_cast<CharType>(is_utf8 && c >= 0x80 ? c : (*d_unicode)(c));
+			}
+		}
+
+		// folds a single code unit; multi-byte utf-8 sequences are left alone
+		CharType operator()(CharType c) const {
+			auto u = static_cast<unsigned_char_type>(c);
+			if (u < d_table.size()) {
+				return d_table[u];
+			}
+			return static_cast<CharType>((*d_unicode)(static_cast<char32_t>(u)));
+		}
+
+		// folds the character starting at first into out, returning the number of
+		// code units consumed and written; a utf-8 sequence whose folding would
+		// encode to a different length is copied unchanged so offsets still hold
+		size_t fold(const CharType* first, const CharType* last, CharType* out) const {
+			auto u = static_cast<unsigned_char_type>(*first);
+			if (!is_utf8 || u < 0x80) {
+				*out = (*this)(*first);
+				return 1;
+			}
+			char32_t cp;
+			size_t len = unicode::utf8_decode(first, last, cp);
+			if (len == 0) {
+				*out = *first;
+				return 1;
+			}
+			CharType buf[max_sequence_length];
+			char32_t folded = (*d_unicode)(cp);
+			if (folded != cp && unicode::utf8_encode(folded, buf) == len) {
+				std::copy(buf, buf + len, out);
+			} else {
+				std::copy(first, first + len, out);
+			}
+			return len;
+		}
+
+		string_type operator()(const string_type& str) const {
+			string_type result(str);
+			const CharType* first = str.data();
+			const CharType* last = first + str.size();
+			for (size_t pos = 0; pos < str.size(); ) {
+				pos += fold(first + pos, last, &result[pos]);
+			}
+			return result;
+		}
+	};
+
+	// class node_pool
+	// room for the transition nodes of one block of a state_arena, handed out
+	// from the front by a bump that threads may share; each node is placed at
+	// its own alignment, so nodes of one type pack end to end. Once the pool
+	// is used up, nodes come from the heap instead. Nothing is given back
+	// before the whole pool is freed
+	class node_pool {
+		typedef std::aligned_storage<sizeof(std::max_align_t), alignof(std::max_align_t)>::type unit;
+
+		std::unique_ptr<unit[]> d_units;
+		size_t                  d_capacity;
+		std::atomic<size_t>     d_used;
+
+	public:
+		explicit node_pool(size_t bytes)
+			: d_units(new unit[(bytes + sizeof(unit) - 1) / sizeof(unit)])
+			, d_capacity(bytes)
+			, d_used(0) {}
+
+		// nullptr when the pool is used up
+		void* allocate(size_t bytes, size_t alignment) {
+			size_t used = d_used.load(std::memory_order_relaxed);
+			size_t offset;
+			do {
+				offset = (used + alignment - 1) / alignment * alignment;
+				if (offset + bytes > d_capacity) {
+					return nullptr;
+				}
+			} while (!d_used.compare_exchange_weak(used, offset + bytes, std::memory_order_relaxed));
+			return reinterpret_cast<unsigned char*>(d_units.get()) + offset;
+		}
+
+		// the bytes not handed out yet
+		size_t unused_bytes() const {
+			return d_capacity - std::min(d_used.load(std::memory_order_relaxed), d_capacity);
+		}
+
+		bool owns(const void* p) const {
+			const unsigned char* begin = reinterpret_cast<const unsigned char*>(d_units.get());
+			const unsigned char* c = static_cast<const unsigned char*>(p);
+			return c >= begin && c < begin + d_capacity;
+		}
+	};
+
+	// class pool_allocator
+	// allocates single objects from a node_pool when it has one and room to
+	// spare, and everything else from the heap
+	template<typename T>
+	class pool_allocator {
+		template<typename>
+		friend class pool_allocator;
+
+		node_pool* d_pool;
+
+	public:
+		typedef T value_type;
+
+		explicit pool_allocator(node_pool* pool = nullptr): d_pool(pool) {}
+
+		template<typename U>
+		pool_allocator(const pool_allocator<U>& other): d_pool(other.d_pool) {}
+
+		node_pool* pool() const { return d_pool; }
+
+		T* allocate(size_t n) {
+			void* p = d_pool != nullptr && n == 1 ? d_pool->allocate(sizeof(T), alignof(T)) : nullptr;
+			return static_cast<T*>(p != nullptr ? p : ::operator new(n * sizeof(T)));
+		}
+
+		void deallocate(T* p, size_t) {
+			if (d_pool == nullptr || !d_pool->owns(p)) {
+				::operator delete(p);
+			}
+		}
+
+		template<typename U>
+		bool operator==(const pool_allocator<U>& other) const { return d_pool == other.d_pool; }
+
+		template<typename U>
+		bool operator!=(const pool_allocator<U>& other) const { return d_pool != other.d_pool; }
+	};
+
+	template<typename CharType>
+	class state_arena;
+
 	// class state
 	template<typename CharType>
 	class state {
+		template<typename>
+		friend class state_arena;
+
 	public:
-		typedef state<CharType>*                 ptr;
-		typedef std::unique_ptr<state<CharType>> unique_ptr;
+		// destroys a state, and frees it unless it lives in a state_arena,
+		// which the states with a node pool do
+		struct deleter {
+			void operator()(state<CharType>* s) const {
+				if (s->d_success.get_allocator().pool() != nullptr) {
+					s->~state();
+				} else {
+					delete s;
+				}
+			}
+		};
+
+		typedef state<CharType>*                          ptr;
+		typedef std::unique_ptr<state<CharType>, deleter> unique_ptr;
 		typedef std::basic_string<CharType>      string_type;
 		typedef std::basic_string<CharType>&     string_ref_type;
 		typedef std::pair<string_type, unsigned> key_index;
 		typedef std::set<key_index>              string_collection;
 		typedef std::vector<ptr>                 state_collection;
 		typedef std::vector<CharType>            transition_collection;
+		typedef std::pair<const CharType, unique_ptr> transition_type;
+		typedef std::map<CharType, unique_ptr, std::less<CharType>, pool_allocator<transition_type>> success_collection;
 
 	private:
 		size_t                         d_depth;
 		ptr                            d_root;
-		std::map<CharType, unique_ptr> d_success;
+		success_collection             d_success;
 		ptr                            d_failure;
 		string_collection              d_emits;
 
-	public:
-		state(): state(0) {}
-
-		explicit state(size_t depth)
+		// a state of a state_arena, whose transitions come from its node pool
+		state(size_t depth, node_pool* transitions)
 			: d_depth(depth)
 			, d_root(depth == 0 ? this : nullptr)
-			, d_success()
+			, d_success(pool_allocator<transition_type>(transitions))
 			, d_failure(nullptr)
 			, d_emits() {}
 
+	public:
+		state(): state(0) {}
+
+		explicit state(size_t depth)
+			: state(depth, nullptr) {}
+
 		ptr next_state(CharType character) const {
 			return next_state(character, false);
 		}
@@ -336,9 +1100,24 @@ namespace aho_corasick {
 			return next;
 		}
 
+		// as add_state, for a character with no transition yet and a state of
+		// the next depth made by the caller, which this state then owns
+		ptr add_state(CharType character, ptr next) {
+			d_success.emplace(character, unique_ptr(next));
+			return next;
+		}
+
+		// as add_state(character, next), for a character known to order after
+		// every existing transition, which lets sorted builds append without
+		// searching
+		ptr append_state(CharType character, ptr next) {
+			d_success.emplace_hint(d_success.end(), character, unique_ptr(next));
+			return next;
+		}
+
 		size_t get_depth() const { return d_depth; }
 
-		void add_emit(string_ref_type keyword, unsigned index) {
+		void add_emit(const string_type& keyword, unsigned index) {
 			d_emits.insert(std::make_pair(keyword, index));
 		}
 
@@ -349,7 +1128,7 @@ namespace aho_corasick {
 			}
 		}
 
-		string_collection get_emits() const { return d_emits; }
+		const string_collection& get_emits() const { return d_emits; }
 
 		ptr failure() const { return d_failure; }
 
@@ -363,6 +1142,8 @@ namespace aho_corasick {
 			return state_collection(result);
 		}
 
+		const success_collection& get_success() const { return d_success; }
+
 		transition_collection get_transitions() const {
 			transition_collection result;
 			for (auto it = d_success.cbegin(); it != d_success.cend(); ++it) {
@@ -384,8 +1165,242 @@ namespace aho_corasick {
 		}
 	};
 
+	// class state_arena
+	// storage for the states of a trie, in blocks that never move once made.
+	// A bulk insert reserves a block sized to the states it will create, and
+	// several threads may each fill a block of their own. The states are
+	// destroyed through the links of their parents; the arena only frees the
+	// memory, so it must outlive the trie's root
+	template<typename CharType>
+	class state_arena {
+	public:
+		typedef state<CharType>  state_type;
+		typedef state<CharType>* ptr;
+
+	private:
+		typedef typename std::aligned_storage<sizeof(state_type), alignof(state_type)>::type slot;
+
+		// struct block
+		// the states, and a node pool with room for a transition to each
+		struct block {
+			std::unique_ptr<slot[]>    slots;
+			size_t                     size;
+			size_t                     capacity;
+			std::unique_ptr<node_pool> transitions;
+		};
+
+		// a tree node carries its colour and three links ahead of the value
+		static const size_t transition_bytes = 4 * sizeof(void*) + sizeof(typename state_type::transition_type);
+
+		std::vector<block> d_blocks;
+		// the block create(depth) takes from, never a reserved one, or past the
+		// end before there is one
+		size_t             d_growing = std::numeric_limits<size_t>::max();
+
+	public:
+		state_arena() = default;
+		state_arena(state_arena&&) = default;
+
+		// swaps, so that the states of the trie being assigned over stay valid
+		// until its root has destroyed them
+		state_arena& operator=(state_arena&& other) {
+			d_blocks.swap(other.d_blocks);
+			std::swap(d_growing, other.d_growing);
+			return *this;
+		}
+
+		// adds a block with room for count states, returning its index
+		size_t reserve(size_t count) {
+			d_blocks.push_back(block{
+				std::unique_ptr<slot[]>(new slot[count]), 0, count,
+				std::unique_ptr<node_pool>(new node_pool(count * transition_bytes)) });
+			return d_blocks.size() - 1;
+		}
+
+		// a state of the given depth from a reserved block, which must have room
+		ptr create(size_t index, size_t depth) {
+			block& b = d_blocks[index];
+			return new (&b.slots[b.size++]) state_type(depth, b.transitions.get());
+		}
+
+		// the bytes reserved in the blocks but not yet taken by a state or a
+		// transition node
+		size_t unused_bytes() const {
+			size_t bytes = 0;
+			for (const auto& b : d_blocks) {
+				bytes += (b.capacity - b.size) * sizeof(slot) + b.transitions->unused_bytes();
+			}
+			return bytes;
+		}
+
+		// a state of the given depth, adding a block twice the size of the last
+		// one, up to a limit, when the block in use is full
+		ptr create(size_t depth) {
+			if (d_growing >= d_blocks.size() || d_blocks[d_growing].size == d_blocks[d_growing].capacity) {
+				const size_t capacity = d_growing < d_blocks.size() ? d_blocks[d_growing].capacity * 2 : 16;
+				d_growing = reserve(std::min<size_t>(capacity, 4096));
+			}
+			return create(d_growing, depth);
+		}
+	};
+
+	// class keyword_set
+	// distinct keyword indexes; membership is kept in a bitmap when the
+	// dictionary is small enough to clear one per scan, and in a hash set
+	// when it is not
+	class keyword_set {
+	public:
+		typedef std::vector<unsigned> index_collection;
+
+	private:
+		bool                         d_dense;
+		std::vector<uint64_t>        d_bits;
+		std::unordered_set<unsigned> d_sparse;
+		index_collection             d_members;
+
+	public:
+		// expected is a rough bound on the number of distinct members
+		keyword_set(size_t num_keywords, size_t expected)
+			: d_dense(num_keywords / 64 <= std::max<size_t>(expected, 64))
+			, d_bits(d_dense ? (num_keywords + 63) / 64 : 0, 0)
+			, d_sparse()
+			, d_members() {}
+
+		// returns whether index was not already a member
+		bool insert(unsigned index) {
+			if (d_dense) {
+				auto& word = d_bits[index / 64];
+				uint64_t bit = uint64_t(1) << (index % 64);
+				if (word & bit) {
+					return false;
+				}
+				word |= bit;
+			} else if (!d_sparse.insert(index).second) {
+				return false;
+			}
+			d_members.push_back(index);
+			return true;
+		}
+
+		size_t size() const { return d_members.size(); }
+
+		index_collection get_members() const {
+			index_collection result(d_members);
+			std::sort(result.begin(), result.end());
+			return result;
+		}
+	};
+
+	// class keyword_histogram
+	class keyword_histogram {
+	public:
+		typedef std::vector<size_t>         count_collection;
+		typedef std::pair<unsigned, size_t> keyword_count;
+		typedef std::vector<keyword_count>  keyword_count_collection;
+
+	private:
+		count_collection d_counts;
+
+	public:
+		explicit keyword_histogram(size_t num_keywords = 0)
+			: d_counts(num_keywords, 0) {}
+
+		size_t get_count(unsigned index) const {
+			return index < d_counts.size() ? d_counts[index] : 0;
+		}
+
+		// indexed by keyword index
+		count_collection& get_counts() { return d_counts; }
+		const count_collection& get_counts() const { return d_counts; }
+
+		size_t total() const {
+			size_t result = 0;
+			for (auto c : d_counts) {
+				result += c;
+			}
+			return result;
+		}
+
+		void merge(const keyword_histogram& other) {
+			if (d_counts.size() < other.d_counts.size()) {
+				d_counts.resize(other.d_counts.size(), 0);
+			}
+			for (size_t i = 0; i < other.d_counts.size(); ++i) {
+				d_counts[i] += other.d_counts[i];
+			}
+		}
+
+		// the k most frequent keywords that occurred at all, most frequent first
+		// and lower indexes first among equals
+		keyword_count_collection top(size_t k) const {
+			keyword_count_collection result;
+			for (size_t i = 0; i < d_counts.size(); ++i) {
+				if (d_counts[i] > 0) {
+					result.push_back(keyword_count(static_cast<unsigned>(i), d_counts[i]));
+				}
+			}
+			auto middle = result.begin() + std::min(k, result.size());
+			std::partial_sort(result.begin(), middle, result.end(), [](const keyword_count& a, const keyword_count& b) -> bool {
+				return a.second > b.second || (a.second == b.second && a.first < b.first);
+			});
+			result.erase(middle, result.end());
+			return result;
+		}
+	};
+
+	// struct trie_stats
+	// byte counts are estimated from the sizes of the objects and of the
+	// red-black tree nodes holding them, not measured from the allocator
+	struct trie_stats {
+		size_t              num_states = 0;
+		size_t              num_transitions = 0;
+		size_t              num_keywords = 0;
+		size_t              num_emits = 0;
+		std::vector<size_t> states_by_depth;
+		// the number of states with each number of transitions
+		std::vector<size_t> fan_out;
+		size_t              state_bytes = 0;
+		size_t              transition_bytes = 0;
+		size_t              emit_bytes = 0;
+		size_t              keyword_bytes = 0;
+		size_t              failure_bytes = 0;
+		// reserved for states and transitions that have not been made yet
+		size_t              reserved_bytes = 0;
+
+		size_t total_bytes() const {
+			return state_bytes + transition_bytes + emit_bytes + keyword_bytes + failure_bytes + reserved_bytes;
+		}
+	};
+
+	// the scan policies of basic_matcher, each fixing one of the trie's
+	// options at compile time through its value
+	namespace policy {
+
+		struct exact_case       { static const bool value = false; };
+		struct fold_case        { static const bool value = true; };
+
+		struct any_boundary     { static const bool value = false; };
+		struct whole_words      { static const bool value = true; };
+
+		struct overlapping      { static const bool value = false; };
+		struct non_overlapping  { static const bool value = true; };
+
+		struct code_units       { static const bool value = false; };
+		struct utf8             { static const bool value = true; };
+
+	} // namespace policy
+
+	template<typename CharType>
+	class basic_trie;
+
+	template<typename CharType, class CaseFold, class WholeWords, class MatchKind, class Encoding = policy::code_units>
+	class basic_matcher;
+
 	template<typename CharType>
 	class basic_trie {
+		template<typename, class, class, class, class>
+		friend class basic_matcher;
+
 	public:
 		using string_type = std::basic_string < CharType > ;
 		using string_ref_type = std::basic_string<CharType>&;
@@ -394,19 +1409,36 @@ namespace aho_corasick {
 		typedef state<CharType>*        state_ptr_type;
 		typedef token<CharType>         token_type;
 		typedef emit<CharType>          emit_type;
-		typedef std::vector<token_type> token_collection;
-		typedef std::vector<emit_type>  emit_collection;
+		typedef token_view<CharType>         token_view_type;
+		typedef std::vector<token_type>      token_collection;
+		typedef std::vector<token_view_type> token_view_collection;
+		typedef std::vector<emit_type>       emit_collection;
+		typedef std::vector<match>           match_collection;
+		typedef keyword_set::index_collection index_collection;
 
 		class config {
-			bool d_allow_overlaps;
-			bool d_only_whole_words;
-			bool d_case_insensitive;
+			typedef typename std::make_unsigned<CharType>::type unsigned_char_type;
+
+			bool                  d_allow_overlaps;
+			bool                  d_only_whole_words;
+			bool                  d_case_insensitive;
+			bool                  d_utf8;
+			std::array<bool, 256> d_word_characters;
 
 		public:
 			config()
 				: d_allow_overlaps(true)
 				, d_only_whole_words(false)
-				, d_case_insensitive(false) {}
+				, d_case_insensitive(false)
+				, d_utf8(false)
+				, d_word_characters()
+			{
+				// bytes above ascii are not characters in their own right
+				unsigned limit = sizeof(CharType) == 1 ? 0x80 : 0x100;
+				for (unsigned c = 0; c < limit; ++c) {
+					d_word_characters[c] = unicode::is_letter(c);
+				}
+			}
 
 			bool is_allow_overlaps() const { return d_allow_overlaps; }
 			void set_allow_overlaps(bool val) { d_allow_overlaps = val; }
@@ -416,13 +1448,43 @@ namespace aho_corasick {
 
 			bool is_case_insensitive() const { return d_case_insensitive; }
 			void set_case_insensitive(bool val) { d_case_insensitive = val; }
+
+			// only meaningful for narrow strings
+			bool is_utf8() const { return d_utf8 && sizeof(CharType) == 1; }
+			void set_utf8(bool val) { d_utf8 = val; }
+
+			// characters outside the table are word characters if they are letters
+			bool is_word_character(CharType c) const {
+				auto u = static_cast<unsigned_char_type>(c);
+				if (u < d_word_characters.size()) {
+					return d_word_characters[u];
+				}
+				return unicode::is_letter(static_cast<char32_t>(u));
+			}
+
+			bool is_word_code_point(char32_t cp) const {
+				if (cp < 0x80) {
+					return d_word_characters[cp];
+				}
+				return unicode::is_letter(cp);
+			}
+			void set_word_character(CharType c, bool val) {
+				auto u = static_cast<unsigned_char_type>(c);
+				if (u < d_word_characters.size()) {
+					d_word_characters[u] = val;
+				}
+			}
 		};
 
 	private:
+		// declared ahead of the root, which destroys the states it holds
+		state_arena<CharType>       d_arena;
 		std::unique_ptr<state_type> d_root;
 		config                      d_config;
+		case_folding<CharType>      d_fold;
 		bool                        d_constructed_failure_states;
 		unsigned                    d_num_keywords = 0;
+		size_t                      d_num_states = 1;
 
 	public:
 		basic_trie(): basic_trie(config()) {}
@@ -430,6 +1492,7 @@ namespace aho_corasick {
 		basic_trie(const config& c)
 			: d_root(new state_type())
 			, d_config(c)
+			, d_fold()
 			, d_constructed_failure_states(false) {}
 
 		basic_trie& case_insensitive() {
@@ -447,25 +1510,167 @@ namespace aho_corasick {
 			return (*this);
 		}
 
+		// match narrow text as utf-8: word boundaries are decided on code points
+		// and emits carry code point offsets alongside byte offsets
+		basic_trie& utf8() {
+			d_config.set_utf8(true);
+			return (*this);
+		}
+
+		basic_trie& word_characters(const string_type& characters) {
+			for (const auto& c : characters) {
+				d_config.set_word_character(c, true);
+			}
+			return (*this);
+		}
+
+		// in case insensitive mode the keyword is folded into the automaton,
+		// so the case must be configured before inserting
 		void insert(string_type keyword) {
 			if (keyword.empty())
 				return;
+			string_type folded(d_config.is_case_insensitive() ? d_fold(keyword) : keyword);
 			state_ptr_type cur_state = d_root.get();
-			for (const auto& ch : keyword) {
-				cur_state = cur_state->add_state(ch);
+			for (const auto& ch : folded) {
+				state_ptr_type next = cur_state->next_state_ignore_root_state(ch);
+				if (next == nullptr) {
+					next = cur_state->add_state(ch, d_arena.create(cur_state->get_depth() + 1));
+					d_num_states++;
+				}
+				cur_state = next;
 			}
 			cur_state->add_emit(keyword, d_num_keywords++);
 			d_constructed_failure_states = false;
 		}
 
+		// equivalent to inserting each keyword in turn, but sorts them first so
+		// that each shares the path of its predecessor; with several threads,
+		// the keywords are sharded by first character and the subtries under
+		// each root transition are built concurrently
+		template<class InputIterator>
+		void insert(InputIterator first, InputIterator last, unsigned num_threads = 1) {
+			// only pointers to the keywords are sorted, and the keywords are read
+			// in place when the range holds strings
+			std::vector<string_type> copies;
+			const key_pointers keywords = keyword_pointers(first, last, copies, in_place<InputIterator>());
+			// the paths are the keywords themselves, unless they are folded
+			std::vector<string_type> folded;
+			key_pointers folded_paths;
+			if (d_config.is_case_insensitive()) {
+				folded.reserve(keywords.size());
+				for (auto keyword : keywords) {
+					folded.push_back(d_fold(*keyword));
+				}
+				for (const auto& path : folded) {
+					folded_paths.push_back(&path);
+				}
+			}
+			const key_pointers& paths = d_config.is_case_insensitive() ? folded_paths : keywords;
+			// ordered as the transitions are, by CharType's operator <, and then
+			// by insertion order; dictionaries often arrive in that order already
+			path_order order(keywords.size());
+			for (size_t i = 0; i < order.size(); ++i) {
+				order[i] = static_cast<unsigned>(i);
+			}
+			const auto path_less = [&paths](unsigned a, unsigned b) -> bool {
+				const string_type& x = *paths[a];
+				const string_type& y = *paths[b];
+				const size_t common = std::min(x.size(), y.size());
+				auto mismatch = std::mismatch(x.begin(), x.begin() + common, y.begin());
+				if (mismatch.first != x.begin() + common) {
+					return *mismatch.first < *mismatch.second;
+				}
+				return x.size() != y.size() ? x.size() < y.size() : a < b;
+			};
+			if (!std::is_sorted(order.begin(), order.end(), path_less)) {
+				std::sort(order.begin(), order.end(), path_less);
+			}
+
+			if (num_threads <= 1) {
+				const size_t block = reserve_sorted(paths, order, 0, order.size(), 0);
+				d_num_states += insert_sorted(paths, order, 0, order.size(), keywords, d_root.get(), false, block);
+			} else {
+				// the root transitions are added up front, so that the shards only
+				// ever write below their own depth one state, each into a block of
+				// its own
+				struct shard {
+					size_t         begin;
+					size_t         end;
+					state_ptr_type base;
+					bool           created;
+					size_t         block;
+				};
+				std::vector<shard> shards;
+				for (size_t begin = 0; begin < order.size(); ) {
+					const CharType first_char = (*paths[order[begin]])[0];
+					size_t end = begin;
+					while (end < order.size() && (*paths[order[end]])[0] == first_char) {
+						end++;
+					}
+					state_ptr_type base = d_root->next_state_ignore_root_state(first_char);
+					bool created = base == nullptr;
+					if (created) {
+						base = d_root->add_state(first_char, d_arena.create(1));
+						d_num_states++;
+					}
+					shards.push_back(shard{ begin, end, base, created, reserve_sorted(paths, order, begin, end, 1) });
+					begin = end;
+				}
+				std::atomic<size_t> next(0);
+				std::atomic<size_t> num_states(0);
+				const auto work = [this, &shards, &next, &num_states, &paths, &order, &keywords]() {
+					for (size_t i = next++; i < shards.size(); i = next++) {
+						const shard& sh = shards[i];
+						num_states += insert_sorted(paths, order, sh.begin, sh.end, keywords, sh.base, sh.created, sh.block);
+					}
+				};
+				std::vector<std::thread> threads;
+				for (unsigned i = 1; i < std::min<size_t>(num_threads, shards.size()); ++i) {
+					threads.push_back(std::thread(work));
+				}
+				work();
+				for (auto& t : threads) {
+					t.join();
+				}
+				d_num_states += num_states;
+			}
+			d_num_keywords += static_cast<unsigned>(keywords.size());
+			d_constructed_failure_states = false;
+		}
+
+		// inserts the keywords in bulk and constructs the failure states
 		template<class InputIterator>
-		void insert(InputIterator first, InputIterator last) {
-			for (InputIterator it = first; first != last; ++it) {
-				insert(*it);
+		void build(InputIterator first, InputIterator last, unsigned num_threads = 1) {
+			insert(first, last, num_threads);
+			build(num_threads);
+		}
+
+		// constructs the failure states now instead of on the next scan, after
+		// which the trie may be scanned from several threads at once; each depth
+		// of the trie is shared out between num_threads threads
+		void build(unsigned num_threads = 1) {
+			if (!d_constructed_failure_states) {
+				construct_failure_states(num_threads);
+			}
+		}
+
+		// a scanner specialised on its policies; its case folding and encoding
+		// must agree with how this trie is configured, since keywords are folded
+		// as they are inserted, or std::logic_error is thrown. The trie must
+		// outlive it and not change while it is used
+		template<class CaseFold, class WholeWords, class MatchKind, class Encoding = policy::code_units>
+		basic_matcher<CharType, CaseFold, WholeWords, MatchKind, Encoding> matcher() {
+			if (CaseFold::value != d_config.is_case_insensitive()) {
+				throw std::logic_error("matcher case folding does not match the trie");
 			}
+			if ((Encoding::value && sizeof(CharType) == 1) != d_config.is_utf8()) {
+				throw std::logic_error("matcher encoding does not match the trie");
+			}
+			check_construct_failure_states();
+			return basic_matcher<CharType, CaseFold, WholeWords, MatchKind, Encoding>(*this);
 		}
 
-		token_collection tokenise(string_type text) {
+		token_collection tokenise(const string_type& text) {
 			token_collection tokens;
 			auto collected_emits = parse_text(text);
 			size_t last_pos = -1;
@@ -482,32 +1687,454 @@ namespace aho_corasick {
 			return token_collection(tokens);
 		}
 
-		emit_collection parse_text(string_type text) {
+		// the views point into text, which must outlive them
+		token_view_collection tokenise_view(const string_type& text) {
+			token_view_collection tokens;
+			tokenise(text, [&tokens](const token_view_type& t) {
+				tokens.push_back(t);
+			});
+			return tokens;
+		}
+
+		// views into a temporary would dangle as soon as the call returns
+		token_view_collection tokenise_view(string_type&& text) = delete;
+
+		// passes every token to sink in order, without collecting them. The
+		// views are only valid while text is, so a sink that keeps them needs
+		// text to outlive the call. With overlaps allowed, matches are taken as
+		// they end, the longest of those ending together first, and any that
+		// starts inside an earlier one is skipped
+		template<class Sink>
+		void tokenise(const string_type& text, Sink&& sink) {
+			size_t next = 0;
+			auto to_sink = [&text, &sink, &next](const match& m) {
+				if (m.get_start() < next) {
+					return;
+				}
+				if (m.get_start() > next) {
+					sink(token_view_type(text.data(), next, m.get_start() - next));
+				}
+				sink(token_view_type(text.data(), m));
+				next = m.get_end() + 1;
+			};
+			if (d_config.is_allow_overlaps()) {
+				match pending(0, 0, 0, 0, 0);
+				bool has_pending = false;
+				visit_matches(text, [&to_sink, &pending, &has_pending](const match& m, const string_type&) -> bool {
+					if (has_pending && pending.get_end() != m.get_end()) {
+						to_sink(pending);
+						has_pending = false;
+					}
+					if (!has_pending || m.get_start() < pending.get_start()) {
+						pending = m;
+						has_pending = true;
+					}
+					return true;
+				});
+				if (has_pending) {
+					to_sink(pending);
+				}
+			} else {
+				for (const auto& m : collect_matches(text)) {
+					to_sink(m);
+				}
+			}
+			if (text.size() > next) {
+				sink(token_view_type(text.data(), next, text.size() - next));
+			}
+		}
+
+		emit_collection parse_text(const string_type& text) {
+			parse_action action = { text, emit_collection() };
+			dispatch_match_kind(action);
+			return std::move(action.result);
+		}
+
+		// stops at the first match; whole words are honoured, but overlaps are
+		// not resolved since any match settles the answer
+		bool contains_any(const string_type& text) {
+			return !visit_matches(text, [](const match&, const string_type&) -> bool {
+				return false;
+			});
+		}
+
+		// the first match the scan reaches, which is the one ending earliest in
+		// the text, or an empty emit if there is none; overlaps are not resolved
+		emit_type find_first(const string_type& text) {
+			emit_type result;
+			visit_matches(text, [&result](const match& m, const string_type& keyword) -> bool {
+				result = emit_type(m.get_start(), m.get_end(), m.get_code_point_start(), m.get_code_point_end(), keyword, m.get_index());
+				return false;
+			});
+			return result;
+		}
+
+		// the distinct keyword indexes matched in text, in ascending order
+		index_collection matched_keywords(const string_type& text) {
+			keyword_set seen(d_num_keywords, text.size());
+			if (!d_config.is_allow_overlaps()) {
+				for (const auto& m : collect_matches(text)) {
+					seen.insert(m.get_index());
+				}
+			} else {
+				visit_matches(text, [&seen](const match& m, const string_type&) -> bool {
+					seen.insert(m.get_index());
+					return true;
+				});
+			}
+			return seen.get_members();
+		}
+
+		// as above, but only reporting the wanted keywords and stopping once
+		// all of them have been seen, unless overlaps have to be resolved
+		index_collection matched_keywords(const string_type& text, const index_collection& wanted) {
+			index_collection sorted_wanted(wanted);
+			std::sort(sorted_wanted.begin(), sorted_wanted.end());
+			sorted_wanted.erase(std::unique(sorted_wanted.begin(), sorted_wanted.end()), sorted_wanted.end());
+			const auto is_wanted = [&sorted_wanted](unsigned index) -> bool {
+				return std::binary_search(sorted_wanted.begin(), sorted_wanted.end(), index);
+			};
+			keyword_set seen(d_num_keywords, sorted_wanted.size());
+			if (!d_config.is_allow_overlaps()) {
+				for (const auto& m : collect_matches(text)) {
+					if (is_wanted(m.get_index())) {
+						seen.insert(m.get_index());
+					}
+				}
+			} else if (!sorted_wanted.empty()) {
+				visit_matches(text, [&seen, &sorted_wanted, &is_wanted](const match& m, const string_type&) -> bool {
+					if (is_wanted(m.get_index())) {
+						seen.insert(m.get_index());
+					}
+					return seen.size() < sorted_wanted.size();
+				});
+			}
+			return seen.get_members();
+		}
+
+		// adds the matches of each keyword in text to histogram
+		size_t count_keywords(const string_type& text, keyword_histogram& histogram) {
+			return count_matches(text, histogram.get_counts());
+		}
+
+		// counts the matches of each keyword across a range of documents, shared
+		// out between num_threads threads that each fill their own histogram
+		template<class RandomAccessIterator>
+		keyword_histogram count_keywords(RandomAccessIterator first, RandomAccessIterator last, unsigned num_threads = 1) {
 			check_construct_failure_states();
-			size_t pos = 0;
-			state_ptr_type cur_state = d_root.get();
-			emit_collection collected_emits;
-			for (auto c : text) {
-				if (d_config.is_case_insensitive()) {
-					c = std::tolower(c);
+			const size_t num_documents = std::distance(first, last);
+			const size_t chunk = 16;
+			num_threads = static_cast<unsigned>(std::max<size_t>(1, std::min<size_t>(num_threads, (num_documents + chunk - 1) / chunk)));
+			std::vector<keyword_histogram> histograms(num_threads, keyword_histogram(d_num_keywords));
+			std::atomic<size_t> next(0);
+			const auto work = [this, first, num_documents, chunk, &next](keyword_histogram& histogram) {
+				for (;;) {
+					size_t begin = next.fetch_add(chunk);
+					if (begin >= num_documents) {
+						break;
+					}
+					size_t end = std::min(begin + chunk, num_documents);
+					for (size_t i = begin; i < end; ++i) {
+						count_keywords(*(first + i), histogram);
+					}
 				}
-				cur_state = get_state(cur_state, c);
-				store_emits(pos, cur_state, collected_emits);
-				pos++;
+			};
+			std::vector<std::thread> threads;
+			for (unsigned i = 1; i < num_threads; ++i) {
+				threads.push_back(std::thread(work, std::ref(histograms[i])));
 			}
-			if (d_config.is_only_whole_words()) {
-				remove_partial_matches(text, collected_emits);
+			work(histograms[0]);
+			for (auto& t : threads) {
+				t.join();
+			}
+			for (unsigned i = 1; i < num_threads; ++i) {
+				histograms[0].merge(histograms[i]);
+			}
+			return std::move(histograms[0]);
+		}
+
+		// the number of emits parse_text would return, without building them
+		size_t count_matches(const string_type& text) {
+			count_action action = { text, 0 };
+			dispatch_match_kind(action);
+			return action.result;
+		}
+
+		// as above, also adding the matches of each keyword to counts, which is
+		// indexed by keyword index and grown to fit if needed
+		size_t count_matches(const string_type& text, std::vector<size_t>& counts) {
+			if (counts.size() < d_num_keywords) {
+				counts.resize(d_num_keywords, 0);
 			}
 			if (!d_config.is_allow_overlaps()) {
-				interval_tree<emit_type> tree(typename interval_tree<emit_type>::interval_collection(collected_emits.begin(), collected_emits.end()));
-				auto tmp = tree.remove_overlaps(collected_emits);
-				collected_emits.swap(tmp);
+				auto matches = collect_matches(text);
+				for (const auto& m : matches) {
+					counts[m.get_index()]++;
+				}
+				return matches.size();
 			}
-			return emit_collection(collected_emits);
+			size_t count = 0;
+			visit_matches(text, [&count, &counts](const match& m, const string_type&) -> bool {
+				counts[m.get_index()]++;
+				count++;
+				return true;
+			});
+			return count;
+		}
+
+		trie_stats stats() const {
+			typedef typename state_type::success_collection::value_type transition_type;
+			typedef typename state_type::string_collection::value_type  emit_entry_type;
+			// a tree node carries its colour and three links ahead of the value
+			const auto node_bytes = [](size_t value_size) -> size_t {
+				return 4 * sizeof(void*) + value_size;
+			};
+			trie_stats result;
+			result.num_keywords = d_num_keywords;
+			result.reserved_bytes = d_arena.unused_bytes();
+			std::vector<state_ptr_type> stack(1, d_root.get());
+			while (!stack.empty()) {
+				state_ptr_type cur_state = stack.back();
+				stack.pop_back();
+				const auto& success = cur_state->get_success();
+				const auto& emits = cur_state->get_emits();
+
+				result.num_states++;
+				result.num_transitions += success.size();
+				result.num_emits += emits.size();
+				size_t depth = cur_state->get_depth();
+				if (result.states_by_depth.size() <= depth) {
+					result.states_by_depth.resize(depth + 1, 0);
+				}
+				result.states_by_depth[depth]++;
+				if (result.fan_out.size() <= success.size()) {
+					result.fan_out.resize(success.size() + 1, 0);
+				}
+				result.fan_out[success.size()]++;
+
+				result.state_bytes += sizeof(state_type) - sizeof(state_ptr_type);
+				result.failure_bytes += sizeof(state_ptr_type);
+				result.transition_bytes += success.size() * node_bytes(sizeof(transition_type));
+				result.emit_bytes += emits.size() * node_bytes(sizeof(emit_entry_type));
+				for (const auto& e : emits) {
+					// short keywords are stored inside the string object itself
+					const char* object = reinterpret_cast<const char*>(&e.first);
+					const char* data = reinterpret_cast<const char*>(e.first.data());
+					if (data < object || data >= object + sizeof(e.first)) {
+						result.keyword_bytes += (e.first.capacity() + 1) * sizeof(CharType);
+					}
+				}
+				for (const auto& s : success) {
+					stack.push_back(s.second.get());
+				}
+			}
+			return result;
 		}
 
 	private:
-		token_type create_fragment(const typename token_type::emit_type& e, string_ref_type text, size_t last_pos) const {
+		typedef std::vector<const string_type*> key_pointers;
+		typedef std::vector<unsigned>           path_order;
+
+		// whether a range's keywords can be pointed to where they are
+		template<class InputIterator>
+		struct in_place: std::integral_constant<bool,
+			std::is_base_of<std::forward_iterator_tag, typename std::iterator_traits<InputIterator>::iterator_category>::value
+			&& std::is_reference<typename std::iterator_traits<InputIterator>::reference>::value
+			&& std::is_same<typename std::iterator_traits<InputIterator>::value_type, string_type>::value> {};
+
+		template<class InputIterator>
+		static key_pointers keyword_pointers(InputIterator first, InputIterator last, std::vector<string_type>&, std::true_type) {
+			key_pointers keywords;
+			keywords.reserve(std::distance(first, last));
+			for (InputIterator it = first; it != last; ++it) {
+				if (!it->empty()) {
+					keywords.push_back(&*it);
+				}
+			}
+			return keywords;
+		}
+
+		template<class InputIterator>
+		static key_pointers keyword_pointers(InputIterator first, InputIterator last, std::vector<string_type>& copies, std::false_type) {
+			for (InputIterator it = first; it != last; ++it) {
+				string_type keyword(*it);
+				if (!keyword.empty()) {
+					copies.push_back(std::move(keyword));
+				}
+			}
+			key_pointers keywords;
+			keywords.reserve(copies.size());
+			for (const auto& keyword : copies) {
+				keywords.push_back(&keyword);
+			}
+			return keywords;
+		}
+
+		// reserves a block for the states that adding the paths named by
+		// order[begin, end), sorted, below a state of base_depth can create:
+		// every character a path does not share with its predecessor, which is
+		// exact when none of those states exist yet
+		size_t reserve_sorted(const key_pointers& paths, const path_order& order, size_t begin, size_t end, size_t base_depth) {
+			size_t count = 0;
+			const string_type* previous = nullptr;
+			for (size_t i = begin; i < end; ++i) {
+				const string_type& path = *paths[order[i]];
+				size_t common = base_depth;
+				if (previous != nullptr) {
+					auto mismatch = std::mismatch(path.begin(), path.begin() + std::min(path.size(), previous->size()), previous->begin());
+					common = mismatch.first - path.begin();
+				}
+				count += path.size() - common;
+				previous = &path;
+			}
+			return d_arena.reserve(count);
+		}
+
+		// adds the paths named by order[begin, end), sorted, below base, which is
+		// the state reached by the characters they all share, taking the states
+		// from the arena block reserve_sorted made for them and returning the
+		// number of states created
+		size_t insert_sorted(const key_pointers& paths, const path_order& order, size_t begin, size_t end, const key_pointers& keywords, state_ptr_type base, bool base_created, size_t block) {
+			if (begin == end) {
+				return 0;
+			}
+			const size_t base_depth = base->get_depth();
+			size_t num_states = 0;
+			// the states along the previous path, and whether each was created by
+			// this call, in which case its transitions are all smaller than ours
+			std::vector<state_ptr_type> stack(1, base);
+			std::vector<bool> created(1, base_created);
+			const string_type* previous = nullptr;
+			for (size_t i = begin; i < end; ++i) {
+				const unsigned index = order[i];
+				const string_type& path = *paths[index];
+				size_t common = base_depth;
+				if (previous != nullptr) {
+					auto mismatch = std::mismatch(path.begin(), path.begin() + std::min(path.size(), previous->size()), previous->begin());
+					common = mismatch.first - path.begin();
+				}
+				stack.resize(common - base_depth + 1);
+				created.resize(common - base_depth + 1);
+				for (size_t depth = common; depth < path.size(); ++depth) {
+					state_ptr_type parent = stack.back();
+					state_ptr_type next = created.back() ? nullptr : parent->next_state_ignore_root_state(path[depth]);
+					const bool create = next == nullptr;
+					if (create) {
+						next = d_arena.create(block, depth + 1);
+						// a state that was there before may have larger transitions
+						if (created.back()) {
+							parent->append_state(path[depth], next);
+						} else {
+							parent->add_state(path[depth], next);
+						}
+						num_states++;
+					}
+					created.push_back(create);
+					stack.push_back(next);
+				}
+				stack.back()->add_emit(*keywords[index], d_num_keywords + index);
+				previous = &path;
+			}
+			return num_states;
+		}
+
+		// struct visit_action
+		// the actions a matcher chosen by the dispatch below is put to, each
+		// keeping what it returns in result
+		template<class Visitor>
+		struct visit_action {
+			const string_type& text;
+			Visitor&           visit;
+			bool               result;
+
+			template<class Matcher>
+			void operator()(const Matcher& m) { result = m.visit_matches(text, visit); }
+		};
+
+		// struct find_action
+		struct find_action {
+			const string_type& text;
+			match_collection   result;
+
+			template<class Matcher>
+			void operator()(const Matcher& m) { result = m.find_matches(text); }
+		};
+
+		// struct parse_action
+		struct parse_action {
+			const string_type& text;
+			emit_collection    result;
+
+			template<class Matcher>
+			void operator()(const Matcher& m) { result = m.parse_text(text); }
+		};
+
+		// struct count_action
+		struct count_action {
+			const string_type& text;
+			size_t             result;
+
+			template<class Matcher>
+			void operator()(const Matcher& m) { result = m.count_matches(text); }
+		};
+
+		// the matches parse_text would return, overlaps resolved as configured
+		match_collection collect_matches(const string_type& text) {
+			find_action action = { text, match_collection() };
+			dispatch_match_kind(action);
+			return std::move(action.result);
+		}
+
+		// calls visit(match, keyword) for every match in scan order, stopping as
+		// soon as visit returns false; returns whether the scan ran to the end.
+		// Overlaps are never resolved here
+		template<class Visitor>
+		bool visit_matches(const string_type& text, Visitor&& visit) {
+			visit_action<Visitor> action = { text, visit, true };
+			dispatch_case<policy::overlapping>(action);
+			return action.result;
+		}
+
+		// the options are settled here, once per call, by handing action the
+		// matcher whose loop was compiled for them
+		template<class Action>
+		void dispatch_match_kind(Action& action) {
+			if (d_config.is_allow_overlaps()) {
+				dispatch_case<policy::overlapping>(action);
+			} else {
+				dispatch_case<policy::non_overlapping>(action);
+			}
+		}
+
+		template<class MatchKind, class Action>
+		void dispatch_case(Action& action) {
+			check_construct_failure_states();
+			if (d_config.is_case_insensitive()) {
+				dispatch_whole_words<MatchKind, policy::fold_case>(action);
+			} else {
+				dispatch_whole_words<MatchKind, policy::exact_case>(action);
+			}
+		}
+
+		template<class MatchKind, class CaseFold, class Action>
+		void dispatch_whole_words(Action& action) const {
+			if (d_config.is_only_whole_words()) {
+				dispatch_encoding<MatchKind, CaseFold, policy::whole_words>(action);
+			} else {
+				dispatch_encoding<MatchKind, CaseFold, policy::any_boundary>(action);
+			}
+		}
+
+		template<class MatchKind, class CaseFold, class WholeWords, class Action>
+		void dispatch_encoding(Action& action) const {
+			if (d_config.is_utf8()) {
+				action(basic_matcher<CharType, CaseFold, WholeWords, MatchKind, policy::utf8>(*this));
+			} else {
+				action(basic_matcher<CharType, CaseFold, WholeWords, MatchKind, policy::code_units>(*this));
+			}
+		}
+
+		token_type create_fragment(const typename token_type::emit_type& e, const string_type& text, size_t last_pos) const {
 			auto start = last_pos + 1;
 			auto end = (e.is_empty()) ? text.size() : e.get_start();
 			auto len = end - start;
@@ -515,7 +2142,7 @@ namespace aho_corasick {
 			return token_type(str);
 		}
 
-		token_type create_match(const typename token_type::emit_type& e, string_ref_type text) const {
+		token_type create_match(const typename token_type::emit_type& e, const string_type& text) const {
 			auto start = e.get_start();
 			auto end = e.get_end() + 1;
 			auto len = end - start;
@@ -523,73 +2150,257 @@ namespace aho_corasick {
 			return token_type(str, e);
 		}
 
-		void remove_partial_matches(string_ref_type search_text, emit_collection& collected_emits) const {
-			size_t size = search_text.size();
-			emit_collection remove_emits;
-			for (const auto& e : collected_emits) {
-				if ((e.get_start() == 0 || !std::isalpha(search_text.at(e.get_start() - 1))) &&
-					(e.get_end() + 1 == size || !std::isalpha(search_text.at(e.get_end() + 1)))
-					) {
-					continue;
+		void check_construct_failure_states() {
+			if (!d_constructed_failure_states) {
+				construct_failure_states(1);
+			}
+		}
+
+		void construct_failure_states(unsigned num_threads) {
+			// breadth first, over a queue sized to hold every state, so that the
+			// states of each depth sit together
+			std::vector<state_ptr_type> q;
+			q.reserve(d_num_states);
+			for (const auto& success : d_root->get_success()) {
+				success.second->set_failure(d_root.get());
+				q.push_back(success.second.get());
+			}
+			for (size_t head = 0; head < q.size(); ++head) {
+				for (const auto& success : q[head]->get_success()) {
+					q.push_back(success.second.get());
+				}
+			}
+
+			// the failure links into a depth only depend on shallower states, so
+			// the children of one depth can be linked in parallel
+			for (size_t first = 0; first < q.size(); ) {
+				size_t last = first;
+				while (last < q.size() && q[last]->get_depth() == q[first]->get_depth()) {
+					last++;
+				}
+				parallel_for(last - first, num_threads, [this, &q, first](size_t begin, size_t end) {
+					for (size_t i = first + begin; i < first + end; ++i) {
+						construct_failure_states(q[i]);
+					}
+				});
+				first = last;
+			}
+			d_constructed_failure_states = true;
+		}
+
+		void construct_failure_states(state_ptr_type cur_state) const {
+			for (const auto& success : cur_state->get_success()) {
+				const auto transition = success.first;
+				state_ptr_type target_state = success.second.get();
+
+				state_ptr_type trace_failure_state = cur_state->failure();
+				while (trace_failure_state->next_state(transition) == nullptr) {
+					trace_failure_state = trace_failure_state->failure();
 				}
-				remove_emits.push_back(e);
+				state_ptr_type new_failure_state = trace_failure_state->next_state(transition);
+				target_state->set_failure(new_failure_state);
+				target_state->add_emit(new_failure_state->get_emits());
+			}
+		}
+
+		// calls f(begin, end) over slices of [0, count), on up to num_threads
+		// threads; small counts are not worth a thread and run inline
+		template<class Function>
+		static void parallel_for(size_t count, unsigned num_threads, Function f) {
+			const size_t min_slice = 1024;
+			size_t slices = std::min<size_t>(num_threads, count / min_slice);
+			if (slices <= 1) {
+				f(0, count);
+				return;
+			}
+			size_t slice = (count + slices - 1) / slices;
+			std::vector<std::thread> threads;
+			for (size_t begin = slice; begin < count; begin += slice) {
+				threads.push_back(std::thread(f, begin, std::min(begin + slice, count)));
 			}
-			for (auto& e : remove_emits) {
-				collected_emits.erase(
-					std::find(collected_emits.begin(), collected_emits.end(), e)
-					);
+			f(0, slice);
+			for (auto& t : threads) {
+				t.join();
 			}
 		}
+	};
+
+	// class basic_matcher
+	// scans with a trie's automaton in a loop compiled for one combination of
+	// options, so that none of them is tested while scanning; basic_trie picks
+	// one per call, or one can be had from basic_trie::matcher and kept
+	template<typename CharType, class CaseFold, class WholeWords, class MatchKind, class Encoding>
+	class basic_matcher {
+	public:
+		typedef basic_trie<CharType>                    trie_type;
+		typedef typename trie_type::string_type         string_type;
+		typedef typename trie_type::state_ptr_type      state_ptr_type;
+		typedef typename trie_type::emit_type           emit_type;
+		typedef typename trie_type::emit_collection     emit_collection;
+		typedef typename trie_type::match_collection    match_collection;
+
+	private:
+		static const bool fold = CaseFold::value;
+		static const bool whole_words = WholeWords::value;
+		static const bool utf8 = Encoding::value && sizeof(CharType) == 1;
+
+		const trie_type& d_trie;
 
-		state_ptr_type get_state(state_ptr_type cur_state, CharType c) const {
+	public:
+		// the failure states of trie must have been constructed
+		explicit basic_matcher(const trie_type& trie) : d_trie(trie) {}
+
+		// as basic_trie::visit_matches
+		template<class Visitor>
+		bool visit_matches(const string_type& text, Visitor&& visit) const {
+			const state_ptr_type root = d_trie.d_root.get();
+			state_ptr_type cur_state = root;
+			size_t code_point = -1;
+			if (fold) {
+				const CharType* last = text.data() + text.size();
+				CharType folded[case_folding<CharType>::max_sequence_length];
+				for (size_t pos = 0; pos < text.size(); ) {
+					size_t len = d_trie.d_fold.fold(text.data() + pos, last, folded);
+					for (size_t i = 0; i < len; ++i, ++pos) {
+						if (utf8 && !unicode::is_continuation(text[pos])) {
+							code_point++;
+						}
+						cur_state = get_state(cur_state, folded[i]);
+						AHO_CORASICK_COUNT(bytes_scanned, 1);
+						AHO_CORASICK_COUNT(root_visits, cur_state == root);
+						if (!visit_emits(text, pos, code_point, cur_state, visit)) {
+							return false;
+						}
+					}
+				}
+			} else {
+				for (size_t pos = 0; pos < text.size(); ++pos) {
+					if (utf8 && !unicode::is_continuation(text[pos])) {
+						code_point++;
+					}
+					cur_state = get_state(cur_state, text[pos]);
+					AHO_CORASICK_COUNT(bytes_scanned, 1);
+					AHO_CORASICK_COUNT(root_visits, cur_state == root);
+					if (!visit_emits(text, pos, code_point, cur_state, visit)) {
+						return false;
+					}
+				}
+			}
+			return true;
+		}
+
+		bool contains_any(const string_type& text) const {
+			return !visit_matches(text, [](const match&, const string_type&) -> bool {
+				return false;
+			});
+		}
+
+		match_collection find_matches(const string_type& text) const {
+			match_collection matches;
+			visit_matches(text, [&matches](const match& m, const string_type&) -> bool {
+				matches.push_back(m);
+				return true;
+			});
+			if (MatchKind::value) {
+				resolve_overlaps(matches);
+			}
+			return matches;
+		}
+
+		size_t count_matches(const string_type& text) const {
+			if (MatchKind::value) {
+				return find_matches(text).size();
+			}
+			size_t count = 0;
+			visit_matches(text, [&count](const match&, const string_type&) -> bool {
+				count++;
+				return true;
+			});
+			return count;
+		}
+
+		emit_collection parse_text(const string_type& text) const {
+			emit_collection emits;
+			visit_matches(text, [&emits](const match& m, const string_type& keyword) -> bool {
+				emits.push_back(emit_type(m.get_start(), m.get_end(), m.get_code_point_start(), m.get_code_point_end(), keyword, m.get_index()));
+				return true;
+			});
+			if (MatchKind::value) {
+				resolve_overlaps(emits);
+			}
+			return emits;
+		}
+
+	private:
+		static state_ptr_type get_state(state_ptr_type cur_state, CharType c) {
 			state_ptr_type result = cur_state->next_state(c);
 			while (result == nullptr) {
+				AHO_CORASICK_COUNT(failure_hops, 1);
 				cur_state = cur_state->failure();
 				result = cur_state->next_state(c);
 			}
 			return result;
 		}
 
-		void check_construct_failure_states() {
-			if (!d_constructed_failure_states) {
-				construct_failure_states();
+		// whether the character starting at pos is a word character
+		bool is_word_at(const string_type& text, size_t pos) const {
+			if (pos >= text.size()) {
+				return false;
+			}
+			if (!utf8) {
+				return d_trie.d_config.is_word_character(text[pos]);
 			}
+			char32_t cp;
+			size_t len = unicode::utf8_decode(text.data() + pos, text.data() + text.size(), cp);
+			return len > 0 && d_trie.d_config.is_word_code_point(cp);
 		}
 
-		void construct_failure_states() {
-			std::queue<state_ptr_type> q;
-			for (auto& depth_one_state : d_root->get_states()) {
-				depth_one_state->set_failure(d_root.get());
-				q.push(depth_one_state);
+		// whether the character ending just before pos is a word character
+		bool is_word_before(const string_type& text, size_t pos) const {
+			if (pos == 0) {
+				return false;
 			}
-			d_constructed_failure_states = true;
-
-			while (!q.empty()) {
-				auto cur_state = q.front();
-				for (const auto& transition : cur_state->get_transitions()) {
-					state_ptr_type target_state = cur_state->next_state(transition);
-					q.push(target_state);
-
-					state_ptr_type trace_failure_state = cur_state->failure();
-					while (trace_failure_state->next_state(transition) == nullptr) {
-						trace_failure_state = trace_failure_state->failure();
-					}
-					state_ptr_type new_failure_state = trace_failure_state->next_state(transition);
-					target_state->set_failure(new_failure_state);
-					target_state->add_emit(new_failure_state->get_emits());
+			size_t start = pos - 1;
+			if (utf8) {
+				while (start > 0 && pos - start < case_folding<CharType>::max_sequence_length && unicode::is_continuation(text[start])) {
+					start--;
 				}
-				q.pop();
 			}
+			return is_word_at(text, start);
 		}
 
-		void store_emits(size_t pos, state_ptr_type cur_state, emit_collection& collected_emits) const {
-			auto emits = cur_state->get_emits();
-			if (!emits.empty()) {
-				for (const auto& str : emits) {
-					auto emit_str = typename emit_type::string_type(str.first);
-					collected_emits.push_back(emit_type(pos - emit_str.size() + 1, pos, emit_str, str.second));
+		template<class Visitor>
+		bool visit_emits(const string_type& text, size_t pos, size_t code_point, state_ptr_type cur_state, Visitor& visit) const {
+			const auto& emits = cur_state->get_emits();
+			if (emits.empty()) {
+				return true;
+			}
+			AHO_CORASICK_COUNT(emits, emits.size());
+			// every keyword ending here shares the same right-hand neighbour
+			if (whole_words && is_word_at(text, pos + 1)) {
+				AHO_CORASICK_COUNT(partial_matches_rejected, emits.size());
+				return true;
+			}
+			for (const auto& str : emits) {
+				auto start = pos - str.first.size() + 1;
+				if (whole_words && is_word_before(text, start)) {
+					AHO_CORASICK_COUNT(partial_matches_rejected, 1);
+					continue;
+				}
+				size_t code_point_start = start;
+				size_t code_point_end = pos;
+				if (utf8) {
+					auto length = std::count_if(str.first.begin(), str.first.end(), [](CharType c) -> bool {
+						return !unicode::is_continuation(c);
+					});
+					code_point_start = code_point - length + 1;
+					code_point_end = code_point;
+				}
+				if (!visit(match(start, pos, code_point_start, code_point_end, str.second), str.first)) {
+					return false;
 				}
 			}
+			return true;
 		}
 	};
 
@@ -0,0 +1,181 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "bench.hpp"
+#include "generators.hpp"
+#include "aho_corasick/aho_corasick.hpp"
+
+namespace ac = aho_corasick;
+
+namespace bench {
+
+	namespace {
+
+		typedef ac::trie::emit_collection emit_collection;
+
+		void run_scan(const options& opts, const char* scenario, const std::string& detail, const std::vector<std::string>& keywords, const std::string& text, bool remove_overlaps) {
+			ac::trie t;
+			if (remove_overlaps) {
+				t.remove_overlaps();
+			}
+			auto start = std::chrono::steady_clock::now();
+			t.build(keywords.begin(), keywords.end());
+			double build_time = seconds_since(start);
+
+			size_t matches = remove_overlaps ? t.parse_text(text).size() : t.count_matches(text);
+			auto time = measure(opts, [&]() -> size_t {
+				return remove_overlaps ? t.parse_text(text).size() : t.count_matches(text);
+			});
+
+			result r("adversarial", scenario);
+			r.param("case", detail)
+			 .param("keywords", keywords.size())
+			 .param("text", bytes_label(text.size()))
+			 .param("api", remove_overlaps ? "parse_text+ro" : "count_matches")
+			 .throughput(time, text.size(), matches)
+			 .metric("build_ms", build_time * 1e3);
+			report(r);
+		}
+
+		// a, aa, aaa, ... a^k over a run of a: every position ends k matches
+		void run_emit_explosion(const options& opts, size_t text_size) {
+			for (size_t k : { 8, 32, 128 }) {
+				std::vector<std::string> keywords;
+				for (size_t len = 1; len <= k; ++len) {
+					keywords.push_back(std::string(len, 'a'));
+				}
+				run_scan(opts, "explosion", "a..a^" + std::to_string(k), keywords, std::string(text_size, 'a'), false);
+				if (k <= 32) {
+					// every match is kept until the overlap pass, so keep the
+					// emit count within memory
+					run_scan(opts, "explosion", "a..a^" + std::to_string(k), keywords, std::string(text_size / 4, 'a'), true);
+				}
+			}
+		}
+
+		// a^i b for every i up to k, scanned over runs of a^k c: each c
+		// follows the failure links back down all k states of the a run. The
+		// state for a^i b also holds the emits of every shorter a^j b, copies
+		// of keywords included, so memory grows with k cubed and k is kept
+		// modest
+		void run_failure_chains(const options& opts, size_t text_size) {
+			for (size_t k : { 16, 128, 512 }) {
+				std::vector<std::string> keywords;
+				for (size_t len = 1; len <= k; ++len) {
+					keywords.push_back(std::string(len, 'a') + "b");
+				}
+				std::string text;
+				while (text.size() < text_size) {
+					text += std::string(k, 'a') + "c";
+				}
+				text.resize(text_size);
+				run_scan(opts, "failure", "a^i b, i<=" + std::to_string(k), keywords, text, false);
+			}
+		}
+
+		// many distinct keywords ending in one long suffix, so that failure
+		// links from every branch converge on the same chain of states
+		void run_shared_suffix(const options& opts, size_t text_size) {
+			rng_type rng(default_seed);
+			const std::string suffix(32, 'z');
+			for (size_t count : { 1000, 10000, 100000 }) {
+				std::vector<std::string> keywords;
+				for (const auto& prefix : random_dictionary(rng, count, 4, 8, alphabet(26))) {
+					keywords.push_back(prefix + suffix);
+				}
+				auto text = planted_text(rng, text_size, keywords, 0.5, alphabet(26));
+				run_scan(opts, "suffix", "x+z^32", keywords, text, false);
+			}
+		}
+
+		// every substring of a short random text as a keyword, over repeats of
+		// it, so that nearly every match overlaps dozens of others
+		void run_overlaps(const options& opts, size_t text_size) {
+			rng_type rng(default_seed);
+			auto chars = alphabet(4);
+			std::string motif = random_string(rng, 64, chars);
+			std::set<std::string> substrings;
+			for (size_t start = 0; start < motif.size(); ++start) {
+				for (size_t len = 2; start + len <= motif.size() && len <= 16; ++len) {
+					substrings.insert(motif.substr(start, len));
+				}
+			}
+			std::vector<std::string> keywords(substrings.begin(), substrings.end());
+			std::string text;
+			while (text.size() < text_size / 4) {
+				text += motif;
+			}
+			run_scan(opts, "overlap", "substrings", keywords, text, true);
+
+			// the overlap passes alone, on the emits that scan produced
+			ac::trie t;
+			t.build(keywords.begin(), keywords.end());
+			emit_collection emits = t.parse_text(text);
+			for (size_t count : { size_t(1000), size_t(20000), emits.size() }) {
+				emit_collection input(emits.begin(), emits.begin() + std::min(count, emits.size()));
+				size_t kept = 0;
+				auto flat_time = measure(opts, [&]() {
+					ac::flat_interval_tree<ac::trie::emit_type> tree(input);
+					kept = tree.remove_overlaps().size();
+					return kept;
+				});
+				result flat("adversarial", "overlap");
+				flat.param("case", "flat_interval_tree")
+				 .param("intervals", input.size())
+				 .metric("intervals/s", input.size() / std::max(flat_time.median, 1e-12))
+				 .metric("median_ms", flat_time.median * 1e3)
+				 .metric("kept", kept);
+				report(flat);
+
+				// the pointer tree erases removed intervals one at a time,
+				// which is quadratic, so it is only run on the smaller inputs
+				if (input.size() > 20000) {
+					continue;
+				}
+				// its count of kept intervals is not reported: the pointer tree
+				// collects removals in a set ordered by start alone, so of the
+				// overlaps sharing a start only the first is removed
+				auto tree_time = measure(opts, [&]() {
+					ac::interval_tree<ac::trie::emit_type> tree(input);
+					return tree.remove_overlaps(input).size();
+				});
+				result pointer("adversarial", "overlap");
+				pointer.param("case", "interval_tree")
+				 .param("intervals", input.size())
+				 .metric("intervals/s", input.size() / std::max(tree_time.median, 1e-12))
+				 .metric("median_ms", tree_time.median * 1e3);
+				report(pointer);
+			}
+		}
+
+	} // namespace
+
+	int run_adversarial(const options& opts) {
+		size_t text_size = opts.quick ? 16 << 10 : opts.full ? 4 << 20 : 256 << 10;
+		run_emit_explosion(opts, text_size);
+		run_failure_chains(opts, text_size);
+		run_shared_suffix(opts, text_size);
+		run_overlaps(opts, text_size);
+		return 0;
+	}
+
+} // namespace bench
@@ -0,0 +1,41 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef AHO_CORASICK_BENCH_ALLOCATIONS_HPP
+#define AHO_CORASICK_BENCH_ALLOCATIONS_HPP
+
+#include <cstddef>
+
+// Counted by the replacement operator new in allocations.cpp, which a program
+// links in to use these; the benchmark and test/allocation_test.cpp both do.
+
+namespace bench {
+
+	// heap allocations made so far by the calling thread
+	std::size_t thread_allocations();
+
+	// bytes requested by those allocations, whether or not freed since
+	std::size_t thread_allocated_bytes();
+
+} // namespace bench
+
+#endif // AHO_CORASICK_BENCH_ALLOCATIONS_HPP
@@ -0,0 +1,423 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef AHO_CORASICK_BENCH_HPP
+#define AHO_CORASICK_BENCH_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "allocations.hpp"
+#include "perf_counters.hpp"
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#ifndef AHO_CORASICK_BUILD_TYPE
+#define AHO_CORASICK_BUILD_TYPE ""
+#endif
+
+namespace bench {
+
+	// struct options
+	struct options {
+		std::string suite = "throughput";
+		size_t      warmup = 1;
+		size_t      repetitions = 5;
+		// widen the sweeps to their largest sizes, which takes several GiB
+		bool        full = false;
+		// shrink the sweeps to smoke test sizes
+		bool        quick = false;
+		// read hardware counters around every timed repetition
+		bool        perf = false;
+		// text, json or csv
+		std::string format = "text";
+		// where results go, standard output when empty
+		std::string output;
+		// the change in percent beyond which compare reports a regression
+		double      threshold = 5.0;
+		std::vector<std::string> arguments;
+	};
+
+	// struct sample_stats
+	struct sample_stats {
+		double min = 0.0;
+		double median = 0.0;
+		double mean = 0.0;
+		double stddev = 0.0;
+		// hardware counts per repetition, when they were asked for
+		perf_counters::value_collection counters;
+
+		static sample_stats of(std::vector<double> samples) {
+			sample_stats stats;
+			if (samples.empty()) {
+				return stats;
+			}
+			std::sort(samples.begin(), samples.end());
+			stats.min = samples.front();
+			size_t mid = samples.size() / 2;
+			stats.median = samples.size() % 2 ? samples[mid] : (samples[mid - 1] + samples[mid]) / 2;
+			for (double s : samples) {
+				stats.mean += s;
+			}
+			stats.mean /= samples.size();
+			for (double s : samples) {
+				stats.stddev += (s - stats.mean) * (s - stats.mean);
+			}
+			stats.stddev = samples.size() > 1 ? std::sqrt(stats.stddev / (samples.size() - 1)) : 0.0;
+			return stats;
+		}
+	};
+
+	// struct result
+	struct result {
+		typedef std::vector<std::pair<std::string, std::string>> param_collection;
+		typedef std::vector<std::pair<std::string, double>>      metric_collection;
+
+		std::string       suite;
+		std::string       name;
+		param_collection  params;
+		metric_collection metrics;
+
+		result(std::string suite, std::string name)
+			: suite(std::move(suite))
+			, name(std::move(name)) {}
+
+		template<typename T>
+		result& param(const std::string& key, const T& value) {
+			std::ostringstream out;
+			out << value;
+			params.emplace_back(key, out.str());
+			return *this;
+		}
+
+		result& metric(const std::string& key, double value) {
+			metrics.emplace_back(key, value);
+			return *this;
+		}
+
+		// the standard set of timing metrics for one run of bytes of input
+		// producing matches, with time in seconds per repetition
+		result& throughput(const sample_stats& time, size_t bytes, size_t matches) {
+			double median = std::max(time.median, 1e-12);
+			metric("MB/s", bytes / median / 1e6);
+			metric("matches/s", matches / median);
+			metric("ns/byte", bytes ? median * 1e9 / bytes : 0.0);
+			metric("median_ms", time.median * 1e3);
+			metric("min_ms", time.min * 1e3);
+			metric("stddev_%", time.mean > 0 ? 100.0 * time.stddev / time.mean : 0.0);
+			double cycles = 0.0;
+			double instructions = 0.0;
+			for (const auto& c : time.counters) {
+				metric(c.first + "/byte", bytes ? c.second / bytes : 0.0);
+				if (c.first == "cycles") {
+					cycles = c.second;
+				}
+				if (c.first == "instructions") {
+					instructions = c.second;
+				}
+			}
+			if (cycles > 0) {
+				metric("IPC", instructions / cycles);
+			}
+			return *this;
+		}
+	};
+
+	// written by do_not_optimize, defined in benchmark.cpp
+	extern volatile size_t optimiser_sink;
+
+	// git describe of the tree the benchmark was built from, defined in
+	// benchmark.cpp
+	extern const char* const git_revision;
+
+	// keeps a result alive so the optimiser cannot drop the work producing it
+	inline void do_not_optimize(size_t value) {
+		optimiser_sink = value;
+	}
+
+	inline double seconds_since(std::chrono::steady_clock::time_point start) {
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// opened once, on first use, for the whole run
+	inline perf_counters& shared_perf_counters() {
+		static perf_counters counters;
+		return counters;
+	}
+
+	// times f, discarding opts.warmup runs before recording opts.repetitions,
+	// and with opts.perf averages the hardware counts of those repetitions
+	template<typename F>
+	sample_stats measure(const options& opts, F f) {
+		for (size_t i = 0; i < opts.warmup; ++i) {
+			do_not_optimize(f());
+		}
+		perf_counters* counters = opts.perf && shared_perf_counters().available() ? &shared_perf_counters() : nullptr;
+		// summed by counter name, with the number of repetitions each was
+		// read in, since stop() leaves out a counter whose read fails
+		perf_counters::value_collection totals;
+		std::vector<size_t> reads;
+		std::vector<double> samples;
+		size_t repetitions = std::max<size_t>(1, opts.repetitions);
+		for (size_t i = 0; i < repetitions; ++i) {
+			if (counters) {
+				counters->start();
+			}
+			auto start = std::chrono::steady_clock::now();
+			do_not_optimize(f());
+			samples.push_back(seconds_since(start));
+			if (counters) {
+				for (const auto& value : counters->stop()) {
+					size_t t = 0;
+					while (t < totals.size() && totals[t].first != value.first) {
+						++t;
+					}
+					if (t == totals.size()) {
+						totals.emplace_back(value.first, 0.0);
+						reads.push_back(0);
+					}
+					totals[t].second += value.second;
+					++reads[t];
+				}
+			}
+		}
+		auto stats = sample_stats::of(samples);
+		for (size_t t = 0; t < totals.size(); ++t) {
+			totals[t].second /= reads[t];
+		}
+		stats.counters = std::move(totals);
+		return stats;
+	}
+
+	// the params of a result as one string, which identifies it between runs
+	inline std::string params_key(const result::param_collection& params) {
+		std::string key;
+		for (const auto& p : params) {
+			key += (key.empty() ? "" : ";") + p.first + "=" + p.second;
+		}
+		return key;
+	}
+
+	// class reporter
+	// writes results as they are made, as aligned text, as one JSON document
+	// or as CSV rows of revision,suite,name,params,metric,value
+	class reporter {
+		std::ofstream d_file;
+		std::ostream* d_out = &std::cout;
+		std::string   d_format = "text";
+		size_t        d_count = 0;
+
+		static std::string quote(const std::string& str) {
+			std::ostringstream out;
+			out << '"';
+			for (char c : str) {
+				if (c == '"' || c == '\\') {
+					out << '\\' << c;
+				} else if (static_cast<unsigned char>(c) < 0x20) {
+					out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << int(c) << std::dec << std::setfill(' ');
+				} else {
+					out << c;
+				}
+			}
+			out << '"';
+			return out.str();
+		}
+
+		static std::string csv_field(const std::string& str) {
+			if (str.find_first_of(",\"\n") == std::string::npos) {
+				return str;
+			}
+			std::string field = "\"";
+			for (char c : str) {
+				field += c == '"' ? "\"\"" : std::string(1, c);
+			}
+			return field + "\"";
+		}
+
+		static std::string number(double value) {
+			if (value != value || value == std::numeric_limits<double>::infinity() || value == -std::numeric_limits<double>::infinity()) {
+				return "null";
+			}
+			std::ostringstream out;
+			out << std::setprecision(std::numeric_limits<double>::digits10) << value;
+			return out.str();
+		}
+
+	public:
+		static reporter& instance() {
+			static reporter r;
+			return r;
+		}
+
+		bool open(const options& opts) {
+			d_format = opts.format;
+			if (d_format != "text" && d_format != "json" && d_format != "csv") {
+				return false;
+			}
+			if (!opts.output.empty()) {
+				d_file.open(opts.output.c_str());
+				if (!d_file) {
+					return false;
+				}
+				d_out = &d_file;
+			}
+			std::ostream& out = *d_out;
+			if (d_format == "json") {
+				out << "{\n  \"revision\": " << quote(git_revision)
+				    << ",\n  \"build_type\": " << quote(AHO_CORASICK_BUILD_TYPE)
+				    << ",\n  \"suite\": " << quote(opts.suite)
+				    << ",\n  \"options\": { \"warmup\": " << opts.warmup
+				    << ", \"repetitions\": " << opts.repetitions
+				    << ", \"quick\": " << (opts.quick ? "true" : "false")
+				    << ", \"full\": " << (opts.full ? "true" : "false")
+				    << ", \"perf\": " << (opts.perf ? "true" : "false") << " }"
+				    << ",\n  \"results\": [";
+			} else if (d_format == "csv") {
+				out << "revision,suite,name,params,metric,value\n";
+			} else {
+				out << "*** Aho-Corasick Benchmark: " << opts.suite << " (" << git_revision << ") ***" << std::endl;
+			}
+			return true;
+		}
+
+		void write(const result& r) {
+			std::ostream& out = *d_out;
+			if (d_format == "json") {
+				out << (d_count ? "," : "") << "\n    { \"suite\": " << quote(r.suite) << ", \"name\": " << quote(r.name) << ", \"params\": {";
+				for (size_t i = 0; i < r.params.size(); ++i) {
+					out << (i ? ", " : " ") << quote(r.params[i].first) << ": " << quote(r.params[i].second);
+				}
+				out << " }, \"metrics\": {";
+				for (size_t i = 0; i < r.metrics.size(); ++i) {
+					out << (i ? ", " : " ") << quote(r.metrics[i].first) << ": " << number(r.metrics[i].second);
+				}
+				out << " } }";
+				out.flush();
+			} else if (d_format == "csv") {
+				std::string prefix = csv_field(git_revision) + "," + csv_field(r.suite) + "," + csv_field(r.name) + "," + csv_field(params_key(r.params)) + ",";
+				for (const auto& m : r.metrics) {
+					out << prefix << csv_field(m.first) << "," << number(m.second) << "\n";
+				}
+				out.flush();
+			} else {
+				out << std::left << std::setw(12) << r.suite << std::setw(16) << r.name;
+				for (const auto& p : r.params) {
+					out << " " << p.first << "=" << p.second;
+				}
+				out << " |" << std::fixed << std::setprecision(2);
+				for (const auto& m : r.metrics) {
+					out << " " << m.first << "=" << m.second;
+				}
+				out << std::endl;
+			}
+			++d_count;
+		}
+
+		void close() {
+			if (d_format == "json") {
+				*d_out << "\n  ]\n}\n";
+			}
+			d_out->flush();
+		}
+	};
+
+	inline void report(const result& r) {
+		reporter::instance().write(r);
+	}
+
+	// struct memory_usage
+	// resident and peak resident set sizes in bytes, which read as zero where
+	// /proc/self/status is unavailable
+	struct memory_usage {
+		size_t rss = 0;
+		size_t peak_rss = 0;
+
+		static memory_usage current() {
+			memory_usage usage;
+			std::ifstream status("/proc/self/status");
+			std::string line;
+			while (std::getline(status, line)) {
+				if (line.compare(0, 6, "VmRSS:") == 0) {
+					usage.rss = std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+				} else if (line.compare(0, 6, "VmHWM:") == 0) {
+					usage.peak_rss = std::strtoull(line.c_str() + 6, nullptr, 10) * 1024;
+				}
+			}
+			return usage;
+		}
+	};
+
+	// coalesces freed heap and returns it to the system. glibc otherwise does
+	// the coalescing in the first large allocation after many small frees,
+	// charging the teardown of one run to the timings of the next
+	inline void release_free_memory() {
+#ifdef __GLIBC__
+		malloc_trim(0);
+#endif
+	}
+
+	// returns freed heap to the system and restarts peak tracking at the
+	// current resident size, so the next peak belongs to the work that follows;
+	// false when the kernel does not support resetting the peak
+	inline bool reset_peak_rss() {
+		release_free_memory();
+		std::ofstream clear_refs("/proc/self/clear_refs");
+		clear_refs << "5";
+		clear_refs.close();
+		return static_cast<bool>(clear_refs);
+	}
+
+	// human readable byte counts for parameter values
+	inline std::string bytes_label(size_t bytes) {
+		std::ostringstream out;
+		if (bytes >= (1 << 20) && bytes % (1 << 20) == 0) {
+			out << (bytes >> 20) << "MiB";
+		} else if (bytes >= (1 << 10) && bytes % (1 << 10) == 0) {
+			out << (bytes >> 10) << "KiB";
+		} else {
+			out << bytes << "B";
+		}
+		return out.str();
+	}
+
+	int run_throughput(const options& opts);
+	int run_build(const options& opts);
+	int run_latency(const options& opts);
+	int run_threads(const options& opts);
+	int run_adversarial(const options& opts);
+	int run_compare(const options& opts);
+
+} // namespace bench
+
+#endif // AHO_CORASICK_BENCH_HPP
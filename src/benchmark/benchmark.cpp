@@ -20,111 +20,104 @@
 * SOFTWARE.
 */
 
-#include "aho_corasick/aho_corasick.hpp"
-#include <chrono>
+#include "bench.hpp"
+#include "git_revision.hpp"
+#include <cstring>
 #include <iostream>
-#include <set>
 #include <string>
-#include <vector>
-
-namespace ac = aho_corasick;
-using trie = ac::trie;
 
 using namespace std;
 
-string gen_str(size_t len) {
-	static const char alphanum[] =
-			"0123456789"
-			"!@#$%^&*"
-			"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
-			"abcdefghijklmnopqrstuvwxyz";
+volatile size_t bench::optimiser_sink = 0;
+
+// regenerated by the build from git describe
+const char* const bench::git_revision = AHO_CORASICK_GIT_REVISION;
+
+namespace {
+
+	struct suite {
+		const char* name;
+		const char* description;
+		int (*run)(const bench::options&);
+	};
+
+	const suite suites[] = {
+		{ "throughput", "scan speed across dictionary, text and flag sweeps", bench::run_throughput },
+		{ "build",      "insert and failure construction time and memory by dictionary shape", bench::run_build },
+		{ "latency",    "per-call latency percentiles and allocations on short texts", bench::run_latency },
+		{ "threads",    "aggregate throughput with threads sharing one automaton", bench::run_threads },
+		{ "adversarial", "worst case dictionaries and texts: emit explosion, failure chains, overlaps", bench::run_adversarial },
+	};
+
+	const char* const formats = "text|json|csv";
 
-	string str;
-	for (int i = 0; i < len; ++i) {
-		str.append(1, alphanum[rand() % (sizeof(alphanum) - 1)]);
+	void usage(const char* program) {
+		cerr << "usage: " << program << " [suite] [--quick|--full] [--perf] [--warmup N] [--repetitions N]" << endl;
+		cerr << "       " << "[--format " << formats << "] [--output FILE]" << endl;
+		cerr << "       " << program << " compare BASELINE CANDIDATE [--threshold PERCENT]" << endl;
+		cerr << "suites:" << endl;
+		for (const auto& s : suites) {
+			cerr << "  " << s.name << "\t" << s.description << endl;
+		}
 	}
-	return string(str);
-}
 
-size_t bench_naive(vector<string> text_strings, vector<string> patterns) {
-	size_t count = 0;
-	for (auto& text : text_strings) {
-		for (auto& pattern : patterns) {
-			size_t pos = text.find(pattern);
-			while (pos != text.npos) {
-				pos = text.find(pattern, pos);
-				count++;
+	bool parse_options(int argc, char** argv, bench::options& opts) {
+		bool have_suite = false;
+		for (int i = 1; i < argc; ++i) {
+			string arg = argv[i];
+			if (arg == "--quick") {
+				opts.quick = true;
+			} else if (arg == "--full") {
+				opts.full = true;
+			} else if (arg == "--perf") {
+				opts.perf = true;
+			} else if ((arg == "--warmup" || arg == "--repetitions") && i + 1 < argc) {
+				size_t value = strtoul(argv[++i], nullptr, 10);
+				(arg == "--warmup" ? opts.warmup : opts.repetitions) = value;
+			} else if (arg == "--format" && i + 1 < argc) {
+				opts.format = argv[++i];
+			} else if (arg == "--output" && i + 1 < argc) {
+				opts.output = argv[++i];
+			} else if (arg == "--threshold" && i + 1 < argc) {
+				opts.threshold = strtod(argv[++i], nullptr);
+			} else if (arg.compare(0, 2, "--") == 0) {
+				return false;
+			} else if (!have_suite) {
+				opts.suite = arg;
+				have_suite = true;
+			} else {
+				opts.arguments.push_back(arg);
 			}
 		}
+		return true;
 	}
-	return count;
-}
 
-size_t bench_aho_corasick(vector<string> text_strings, trie& t) {
-	size_t count = 0;
-	for (auto& text : text_strings) {
-		auto matches = t.parse_text(text);
-		count += matches.size();
-	}
-	return count;
-}
+} // namespace
 
 int main(int argc, char** argv) {
-	cout << "*** Aho-Corasick Benchmark ***" << endl;
-
-	cout << "Generating input text ...";
-	set<string> input_strings;
-	while (input_strings.size() < 10) {
-		input_strings.insert(gen_str(256));
+	bench::options opts;
+	if (!parse_options(argc, argv, opts)) {
+		usage(argv[0]);
+		return 2;
 	}
-	vector<string> input_vector(input_strings.begin(), input_strings.end());
-	cout << " done" << endl;
-
-	cout << "Generating search patterns ...";
-	set<string> patterns;
-	while (patterns.size() < 1000000) {
-		patterns.insert(gen_str(8));
+	if (opts.suite == "compare") {
+		return bench::run_compare(opts);
 	}
-	vector<string> pattern_vector(patterns.begin(), patterns.end());
-	cout << " done" << endl;
-
-	cout << "Generating trie ...";
-	trie t;
-	for (auto& pattern : patterns) {
-		t.insert(pattern);
+	if (opts.perf && !bench::shared_perf_counters().available()) {
+		cerr << "hardware counters are unavailable here, reporting timings only" << endl;
 	}
-	cout << " done" << endl;
-
-	map<size_t, tuple<chrono::high_resolution_clock::duration, chrono::high_resolution_clock::duration>> timings;
-
-	cout << "Running ";
-	for (size_t i = 10; i > 0; --i) {
-		cout << ".";
-		auto start_time = chrono::high_resolution_clock::now();
-		size_t count_1 = bench_naive(input_vector, pattern_vector);
-		auto end_time = chrono::high_resolution_clock::now();
-		auto time_1 = end_time - start_time;
-
-		start_time = chrono::high_resolution_clock::now();
-		size_t count_2 = bench_aho_corasick(input_vector, t);
-		end_time = chrono::high_resolution_clock::now();
-		auto time_2 = end_time - start_time;
-
-		if (count_1 != count_2) {
-			cout << "failed" << endl;
+	for (const auto& s : suites) {
+		if (opts.suite == s.name) {
+			auto& reporter = bench::reporter::instance();
+			if (!reporter.open(opts)) {
+				cerr << "cannot write " << opts.format << " results to " << (opts.output.empty() ? "standard output" : opts.output) << endl;
+				return 2;
+			}
+			int status = s.run(opts);
+			reporter.close();
+			return status;
 		}
-
-		timings[i] = make_tuple(time_1, time_2);
-	}
-	cout << " done" << endl;
-
-	cout << "Results: " << endl;
-	for (auto& i : timings) {
-		cout << "  loop #" << i.first;
-		cout << ", naive: " << chrono::duration_cast<chrono::milliseconds>(get<0>(i.second)).count();
-		cout << "ms, ac: " << chrono::duration_cast<chrono::milliseconds>(get<1>(i.second)).count() << "ms";
-		cout << endl;
 	}
-
-	return 0;
-}
\ No newline at end of file
+	usage(argv[0]);
+	return 2;
+}
@@ -0,0 +1,150 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "bench.hpp"
+#include "generators.hpp"
+#include "aho_corasick/aho_corasick.hpp"
+
+namespace ac = aho_corasick;
+
+namespace bench {
+
+	namespace {
+
+		typedef std::vector<std::string> (*dictionary_generator)(rng_type&, size_t);
+
+		std::vector<std::string> random_keywords(rng_type& rng, size_t count) {
+			return random_dictionary(rng, count, 4, 12, alphabet(26));
+		}
+
+		// struct shape
+		struct shape {
+			const char*          name;
+			dictionary_generator generate;
+		};
+
+		const shape shapes[] = {
+			{ "random", random_keywords },
+			{ "prefix", prefix_dictionary },
+			{ "words",  word_dictionary },
+			{ "urls",   url_dictionary },
+		};
+
+		void run_shape(const options& opts, const shape& s, size_t size, bool bulk) {
+			rng_type rng(default_seed);
+			auto keywords = s.generate(rng, size);
+			size_t keyword_bytes = 0;
+			for (const auto& keyword : keywords) {
+				keyword_bytes += keyword.size();
+			}
+
+			std::vector<double> insert_times;
+			std::vector<double> failure_times;
+			memory_usage before;
+			memory_usage after;
+			ac::trie_stats stats;
+			size_t allocations = 0;
+			size_t allocated_bytes = 0;
+			bool have_peak = false;
+			size_t runs = opts.warmup + std::max<size_t>(1, opts.repetitions);
+			for (size_t run = 0; run < runs; ++run) {
+				// memory is taken from the first run, before freed trie nodes
+				// are back on the heap to be reused
+				bool first = run == 0;
+				release_free_memory();
+				if (first) {
+					have_peak = reset_peak_rss();
+					before = memory_usage::current();
+					allocations = thread_allocations();
+					allocated_bytes = thread_allocated_bytes();
+				}
+				ac::trie t;
+				auto start = std::chrono::steady_clock::now();
+				if (bulk) {
+					t.insert(keywords.begin(), keywords.end());
+				} else {
+					for (const auto& keyword : keywords) {
+						t.insert(keyword);
+					}
+				}
+				double insert_time = seconds_since(start);
+				start = std::chrono::steady_clock::now();
+				t.build();
+				double failure_time = seconds_since(start);
+				if (first) {
+					// before reading /proc, which allocates
+					allocations = thread_allocations() - allocations;
+					allocated_bytes = thread_allocated_bytes() - allocated_bytes;
+					after = memory_usage::current();
+					stats = t.stats();
+				}
+				if (run >= opts.warmup) {
+					insert_times.push_back(insert_time);
+					failure_times.push_back(failure_time);
+				}
+			}
+
+			auto insert_time = sample_stats::of(insert_times);
+			auto failure_time = sample_stats::of(failure_times);
+			const double mib = 1 << 20;
+			size_t count = std::max<size_t>(1, keywords.size());
+
+			result r("build", s.name);
+			r.param("keywords", keywords.size())
+			 .param("bytes", bytes_label(keyword_bytes))
+			 .param("insert", bulk ? "bulk" : "incremental")
+			 .metric("keywords/s", keywords.size() / std::max(insert_time.median, 1e-12))
+			 .metric("insert_ms", insert_time.median * 1e3)
+			 .metric("failure_ms", failure_time.median * 1e3)
+			 .metric("total_ms", (insert_time.median + failure_time.median) * 1e3)
+			 .metric("states", stats.num_states)
+			 .metric("rss_MiB", (after.rss - std::min(after.rss, before.rss)) / mib);
+			if (have_peak) {
+				r.metric("peak_MiB", (after.peak_rss - std::min(after.peak_rss, before.rss)) / mib);
+			}
+			r.metric("bytes/keyword", static_cast<double>(stats.total_bytes()) / count)
+			 .metric("rss_bytes/keyword", static_cast<double>(after.rss - std::min(after.rss, before.rss)) / count)
+			 .metric("allocs/keyword", static_cast<double>(allocations) / count)
+			 .metric("alloc_bytes/keyword", static_cast<double>(allocated_bytes) / count);
+			report(r);
+		}
+
+	} // namespace
+
+	int run_build(const options& opts) {
+		std::vector<size_t> sizes = { 1000, 10000, 100000 };
+		if (opts.full) {
+			sizes.push_back(1000000);
+		} else if (opts.quick) {
+			sizes.pop_back();
+		}
+		for (const auto& s : shapes) {
+			for (size_t size : sizes) {
+				for (bool bulk : { false, true }) {
+					run_shape(opts, s, size, bulk);
+				}
+			}
+		}
+		return 0;
+	}
+
+} // namespace bench
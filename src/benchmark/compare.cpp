@@ -0,0 +1,360 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "bench.hpp"
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <stdexcept>
+
+namespace bench {
+
+	namespace {
+
+		// struct record
+		// the metrics of one result, keyed by suite, name and params
+		struct record {
+			std::string                   key;
+			std::map<std::string, double> metrics;
+		};
+
+		typedef std::vector<record> record_collection;
+
+		// class json_reader
+		// reads the results array of a document written by reporter, skipping
+		// anything else
+		class json_reader {
+			const std::string& d_text;
+			size_t             d_pos = 0;
+
+			void skip_space() {
+				while (d_pos < d_text.size() && std::isspace(static_cast<unsigned char>(d_text[d_pos]))) {
+					++d_pos;
+				}
+			}
+
+			bool accept(char c) {
+				skip_space();
+				if (d_pos < d_text.size() && d_text[d_pos] == c) {
+					++d_pos;
+					return true;
+				}
+				return false;
+			}
+
+			void expect(char c) {
+				if (!accept(c)) {
+					throw std::runtime_error(std::string("expected '") + c + "' at offset " + std::to_string(d_pos));
+				}
+			}
+
+			std::string read_string() {
+				expect('"');
+				std::string str;
+				while (d_pos < d_text.size() && d_text[d_pos] != '"') {
+					char c = d_text[d_pos++];
+					if (c == '\\' && d_pos < d_text.size()) {
+						c = d_text[d_pos++];
+						if (c == 'u') {
+							c = static_cast<char>(std::strtoul(d_text.substr(d_pos, 4).c_str(), nullptr, 16));
+							d_pos += 4;
+						} else if (c == 'n') {
+							c = '\n';
+						} else if (c == 't') {
+							c = '\t';
+						}
+					}
+					str += c;
+				}
+				expect('"');
+				return str;
+			}
+
+			// a number, or NaN for null
+			double read_number() {
+				skip_space();
+				if (d_text.compare(d_pos, 4, "null") == 0) {
+					d_pos += 4;
+					return std::numeric_limits<double>::quiet_NaN();
+				}
+				const char* start = d_text.c_str() + d_pos;
+				char* end = nullptr;
+				double value = std::strtod(start, &end);
+				if (end == start) {
+					throw std::runtime_error("expected a number at offset " + std::to_string(d_pos));
+				}
+				d_pos += end - start;
+				return value;
+			}
+
+			void skip_value() {
+				skip_space();
+				if (d_pos >= d_text.size()) {
+					throw std::runtime_error("unexpected end of document");
+				}
+				char c = d_text[d_pos];
+				if (c == '"') {
+					read_string();
+				} else if (c == '{' || c == '[') {
+					char close = c == '{' ? '}' : ']';
+					++d_pos;
+					if (accept(close)) {
+						return;
+					}
+					do {
+						if (close == '}') {
+							read_string();
+							expect(':');
+						}
+						skip_value();
+					} while (accept(','));
+					expect(close);
+				} else {
+					while (d_pos < d_text.size() && d_text[d_pos] != ',' && d_text[d_pos] != '}' && d_text[d_pos] != ']') {
+						++d_pos;
+					}
+				}
+			}
+
+			record read_result() {
+				std::string suite, name;
+				result::param_collection params;
+				record r;
+				expect('{');
+				do {
+					std::string member = read_string();
+					expect(':');
+					if (member == "suite") {
+						suite = read_string();
+					} else if (member == "name") {
+						name = read_string();
+					} else if (member == "params" || member == "metrics") {
+						expect('{');
+						if (!accept('}')) {
+							do {
+								std::string key = read_string();
+								expect(':');
+								if (member == "params") {
+									params.emplace_back(key, read_string());
+								} else {
+									r.metrics[key] = read_number();
+								}
+							} while (accept(','));
+							expect('}');
+						}
+					} else {
+						skip_value();
+					}
+				} while (accept(','));
+				expect('}');
+				r.key = suite + "/" + name + " " + params_key(params);
+				return r;
+			}
+
+		public:
+			explicit json_reader(const std::string& text) : d_text(text) {}
+
+			record_collection read() {
+				record_collection records;
+				expect('{');
+				do {
+					std::string member = read_string();
+					expect(':');
+					if (member != "results") {
+						skip_value();
+						continue;
+					}
+					expect('[');
+					if (!accept(']')) {
+						do {
+							records.push_back(read_result());
+						} while (accept(','));
+						expect(']');
+					}
+				} while (accept(','));
+				expect('}');
+				return records;
+			}
+		};
+
+		std::vector<std::string> csv_fields(const std::string& line) {
+			std::vector<std::string> fields(1);
+			bool quoted = false;
+			for (size_t i = 0; i < line.size(); ++i) {
+				char c = line[i];
+				if (quoted) {
+					if (c == '"' && i + 1 < line.size() && line[i + 1] == '"') {
+						fields.back() += c;
+						++i;
+					} else if (c == '"') {
+						quoted = false;
+					} else {
+						fields.back() += c;
+					}
+				} else if (c == '"') {
+					quoted = true;
+				} else if (c == ',') {
+					fields.emplace_back();
+				} else {
+					fields.back() += c;
+				}
+			}
+			return fields;
+		}
+
+		record_collection read_csv(const std::string& text) {
+			record_collection records;
+			std::map<std::string, size_t> positions;
+			std::istringstream in(text);
+			std::string line;
+			std::getline(in, line);
+			while (std::getline(in, line)) {
+				auto fields = csv_fields(line);
+				if (fields.size() != 6) {
+					continue;
+				}
+				std::string key = fields[1] + "/" + fields[2] + " " + fields[3];
+				auto found = positions.find(key);
+				if (found == positions.end()) {
+					found = positions.emplace(key, records.size()).first;
+					records.push_back(record{ key, {} });
+				}
+				double value = fields[5] == "null" ? std::numeric_limits<double>::quiet_NaN() : std::strtod(fields[5].c_str(), nullptr);
+				records[found->second].metrics[fields[4]] = value;
+			}
+			return records;
+		}
+
+		record_collection read_results(const std::string& path) {
+			std::ifstream in(path.c_str());
+			if (!in) {
+				throw std::runtime_error("cannot read " + path);
+			}
+			std::stringstream buffer;
+			buffer << in.rdbuf();
+			std::string text = buffer.str();
+			size_t first = text.find_first_not_of(" \t\r\n");
+			if (first != std::string::npos && text[first] == '{') {
+				return json_reader(text).read();
+			}
+			return read_csv(text);
+		}
+
+		bool ends_with(const std::string& str, const std::string& suffix) {
+			return str.size() >= suffix.size() && str.compare(str.size() - suffix.size(), suffix.size(), suffix) == 0;
+		}
+
+		// +1 where a larger value is better, -1 where a smaller one is and 0
+		// for counts and spreads that are not performance in themselves
+		int direction(const std::string& metric) {
+			if (ends_with(metric, "/s") || metric == "speedup" || metric == "efficiency_%" || metric == "IPC") {
+				return 1;
+			}
+			if (ends_with(metric, "_ns") || ends_with(metric, "_ms") || ends_with(metric, "_MiB")
+				|| ends_with(metric, "/byte") || ends_with(metric, "/call") || ends_with(metric, "/doc")
+				|| ends_with(metric, "/keyword")) {
+				return -1;
+			}
+			return 0;
+		}
+
+	} // namespace
+
+	int run_compare(const options& opts) {
+		if (opts.arguments.size() != 2) {
+			std::cerr << "compare needs a baseline and a candidate result file" << std::endl;
+			return 2;
+		}
+		record_collection baseline, candidate;
+		try {
+			baseline = read_results(opts.arguments[0]);
+			candidate = read_results(opts.arguments[1]);
+		} catch (const std::exception& e) {
+			std::cerr << e.what() << std::endl;
+			return 2;
+		}
+
+		std::map<std::string, const record*> candidates;
+		for (const auto& r : candidate) {
+			candidates[r.key] = &r;
+		}
+
+		size_t compared = 0, regressions = 0, improvements = 0, missing = 0, failures = 0;
+		std::cout << std::fixed << std::setprecision(2);
+		for (const auto& base : baseline) {
+			auto found = candidates.find(base.key);
+			if (found == candidates.end()) {
+				std::cout << "MISSING     " << base.key << std::endl;
+				++missing;
+				continue;
+			}
+			for (const auto& m : base.metrics) {
+				int better = direction(m.first);
+				if (better == 0 || std::isnan(m.second)) {
+					continue;
+				}
+				auto other = found->second->metrics.find(m.first);
+				if (other == found->second->metrics.end() || std::isnan(other->second)) {
+					++failures;
+					std::cout << "FAILURE     " << base.key << " " << m.first << ": "
+					          << m.second << " -> no value" << std::endl;
+					continue;
+				}
+				++compared;
+				bool worse, moved;
+				if (m.second == 0) {
+					// a zero baseline, as for allocations, has no relative change
+					// so any move away from it counts
+					moved = other->second != 0;
+					worse = (other->second - m.second) * better < 0;
+				} else {
+					double change = 100.0 * (other->second - m.second) / std::abs(m.second);
+					moved = std::abs(change) > opts.threshold;
+					worse = change * better < 0;
+				}
+				if (!moved) {
+					continue;
+				}
+				(worse ? regressions : improvements)++;
+				std::cout << (worse ? "REGRESSION  " : "improvement ") << base.key << " " << m.first << ": "
+				          << m.second << " -> " << other->second;
+				if (m.second != 0) {
+					std::cout << " (" << std::showpos << 100.0 * (other->second - m.second) / std::abs(m.second) << std::noshowpos << "%)";
+				}
+				std::cout << std::endl;
+			}
+		}
+		std::cout << compared << " metrics compared at a " << opts.threshold << "% threshold: "
+		          << regressions << " regressions, " << improvements << " improvements";
+		if (failures) {
+			std::cout << ", " << failures << " metrics without a candidate value";
+		}
+		if (missing) {
+			std::cout << ", " << missing << " baseline results missing from the candidate";
+		}
+		std::cout << std::endl;
+		return regressions || failures || missing ? 1 : 0;
+	}
+
+} // namespace bench
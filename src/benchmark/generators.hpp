@@ -0,0 +1,395 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef AHO_CORASICK_BENCH_GENERATORS_HPP
+#define AHO_CORASICK_BENCH_GENERATORS_HPP
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+	typedef std::mt19937_64 rng_type;
+
+	// every generator takes its own engine so runs are reproducible
+	const rng_type::result_type default_seed = 20150101;
+
+	// the first size characters of a fixed printable ordering, falling back to
+	// every byte value for alphabets larger than that
+	inline std::string alphabet(size_t size) {
+		static const std::string printable =
+			"abcdefghijklmnopqrstuvwxyz"
+			"ABCDEFGHIJKLMNOPQRSTUVWXYZ"
+			"0123456789"
+			"!@#$%^&*()-_=+[]{};:'\",.<>/?|\\`~";
+		if (size <= printable.size()) {
+			return printable.substr(0, std::max<size_t>(1, size));
+		}
+		std::string result;
+		for (size_t c = 0; c < std::min<size_t>(size, 256); ++c) {
+			result.push_back(static_cast<char>(c));
+		}
+		return result;
+	}
+
+	inline std::string random_string(rng_type& rng, size_t len, const std::string& chars) {
+		std::uniform_int_distribution<size_t> pick(0, chars.size() - 1);
+		std::string str;
+		str.reserve(len);
+		for (size_t i = 0; i < len; ++i) {
+			str.push_back(chars[pick(rng)]);
+		}
+		return str;
+	}
+
+	// count distinct keywords with lengths uniform in [min_len, max_len]; asks
+	// for fewer than requested when the alphabet cannot supply that many
+	inline std::vector<std::string> random_dictionary(rng_type& rng, size_t count, size_t min_len, size_t max_len, const std::string& chars) {
+		std::uniform_int_distribution<size_t> length(min_len, max_len);
+		std::set<std::string> keywords;
+		size_t attempts = 0;
+		while (keywords.size() < count && attempts++ < count * 4) {
+			keywords.insert(random_string(rng, length(rng), chars));
+		}
+		return std::vector<std::string>(keywords.begin(), keywords.end());
+	}
+
+	// keywords that share one of a few long prefixes, as in product codes or
+	// hierarchical identifiers, so the trie is deep and narrow near the root
+	inline std::vector<std::string> prefix_dictionary(rng_type& rng, size_t count) {
+		auto chars = alphabet(36);
+		std::vector<std::string> prefixes;
+		for (size_t i = 0; i < 16; ++i) {
+			prefixes.push_back(random_string(rng, 12, chars));
+		}
+		std::uniform_int_distribution<size_t> pick(0, prefixes.size() - 1);
+		std::uniform_int_distribution<size_t> length(2, 8);
+		std::set<std::string> keywords;
+		size_t attempts = 0;
+		while (keywords.size() < count && attempts++ < count * 4) {
+			keywords.insert(prefixes[pick(rng)] + random_string(rng, length(rng), chars));
+		}
+		return std::vector<std::string>(keywords.begin(), keywords.end());
+	}
+
+	// a pronounceable word built from one to four syllables, standing in for
+	// natural language vocabulary
+	inline std::string random_word(rng_type& rng) {
+		static const char* const onsets[] = {
+			"", "b", "c", "d", "f", "g", "h", "l", "m", "n", "p", "r", "s", "t", "w",
+			"br", "ch", "cl", "dr", "gr", "pl", "sh", "st", "th", "tr"
+		};
+		static const char* const vowels[] = { "a", "e", "i", "o", "u", "ai", "ea", "ee", "ou", "y" };
+		static const char* const codas[] = { "", "", "", "n", "r", "s", "t", "l", "ng", "st", "nd", "ck" };
+		std::uniform_int_distribution<size_t> syllables(1, 4);
+		std::uniform_int_distribution<size_t> onset(0, sizeof(onsets) / sizeof(onsets[0]) - 1);
+		std::uniform_int_distribution<size_t> vowel(0, sizeof(vowels) / sizeof(vowels[0]) - 1);
+		std::uniform_int_distribution<size_t> coda(0, sizeof(codas) / sizeof(codas[0]) - 1);
+		std::string word;
+		for (size_t i = syllables(rng); i > 0; --i) {
+			word += onsets[onset(rng)];
+			word += vowels[vowel(rng)];
+			word += codas[coda(rng)];
+		}
+		return word;
+	}
+
+	inline std::vector<std::string> word_dictionary(rng_type& rng, size_t count) {
+		std::set<std::string> keywords;
+		size_t attempts = 0;
+		while (keywords.size() < count && attempts++ < count * 8) {
+			keywords.insert(random_word(rng));
+		}
+		return std::vector<std::string>(keywords.begin(), keywords.end());
+	}
+
+	inline std::string random_url(rng_type& rng) {
+		static const char* const schemes[] = { "http://", "https://" };
+		static const char* const tlds[] = { ".com", ".org", ".net", ".io", ".co.uk" };
+		std::uniform_int_distribution<size_t> scheme(0, 1);
+		std::uniform_int_distribution<size_t> tld(0, sizeof(tlds) / sizeof(tlds[0]) - 1);
+		std::uniform_int_distribution<size_t> segments(0, 4);
+		std::string url = schemes[scheme(rng)];
+		url += "www." + random_word(rng) + tlds[tld(rng)];
+		for (size_t i = segments(rng); i > 0; --i) {
+			url += "/" + random_word(rng);
+		}
+		return url;
+	}
+
+	// URLs drawn from a limited set of hosts, so they share long prefixes
+	inline std::vector<std::string> url_dictionary(rng_type& rng, size_t count) {
+		std::set<std::string> keywords;
+		size_t attempts = 0;
+		while (keywords.size() < count && attempts++ < count * 4) {
+			keywords.insert(random_url(rng));
+		}
+		return std::vector<std::string>(keywords.begin(), keywords.end());
+	}
+
+	// space separated words, cut to len bytes
+	inline std::string word_text(rng_type& rng, size_t len) {
+		std::string text;
+		while (text.size() < len) {
+			text += random_word(rng);
+			text += ' ';
+		}
+		text.resize(len);
+		return text;
+	}
+
+	// random text of len bytes with dictionary keywords planted so that
+	// roughly density of its bytes fall inside a planted keyword
+	inline std::string planted_text(rng_type& rng, size_t len, const std::vector<std::string>& keywords, double density, const std::string& chars) {
+		std::string text = random_string(rng, len, chars);
+		// only the keywords that fit in the text can be planted
+		std::vector<const std::string*> fitting;
+		for (const auto& keyword : keywords) {
+			if (!keyword.empty() && keyword.size() <= len) {
+				fitting.push_back(&keyword);
+			}
+		}
+		if (fitting.empty() || density <= 0.0) {
+			return text;
+		}
+		std::uniform_int_distribution<size_t> pick(0, fitting.size() - 1);
+		size_t covered = 0;
+		size_t target = static_cast<size_t>(len * std::min(density, 1.0));
+		while (covered < target) {
+			const auto& keyword = *fitting[pick(rng)];
+			size_t pos = std::uniform_int_distribution<size_t>(0, len - keyword.size())(rng);
+			text.replace(pos, keyword.size(), keyword);
+			covered += keyword.size();
+		}
+		return text;
+	}
+
+	// class zipf_distribution
+	// ranks in [0, n) where rank r is drawn with probability proportional to
+	// 1 / (r + 1)^s, as word frequencies in natural language roughly are
+	class zipf_distribution {
+		std::vector<double> d_cdf;
+
+	public:
+		explicit zipf_distribution(size_t n, double s = 1.0) : d_cdf(n) {
+			double total = 0.0;
+			for (size_t r = 0; r < n; ++r) {
+				total += 1.0 / std::pow(r + 1.0, s);
+				d_cdf[r] = total;
+			}
+			for (auto& c : d_cdf) {
+				c /= total;
+			}
+		}
+
+		size_t operator()(rng_type& rng) const {
+			double u = std::uniform_real_distribution<double>(0.0, 1.0)(rng);
+			auto found = std::lower_bound(d_cdf.begin(), d_cdf.end(), u);
+			return std::min<size_t>(found - d_cdf.begin(), d_cdf.size() - 1);
+		}
+	};
+
+	// count words ordered by rank, shortest first, as the most frequent words
+	// of a language tend to be its shortest
+	inline std::vector<std::string> ranked_vocabulary(rng_type& rng, size_t count) {
+		auto words = word_dictionary(rng, count);
+		std::shuffle(words.begin(), words.end(), rng);
+		std::stable_sort(words.begin(), words.end(), [](const std::string& a, const std::string& b) {
+			return a.size() < b.size();
+		});
+		return words;
+	}
+
+	// sentences of words drawn from vocabulary by Zipf rank, so that common
+	// words recur as they do in prose
+	inline std::string zipf_text(rng_type& rng, size_t len, const std::vector<std::string>& vocabulary) {
+		zipf_distribution rank(vocabulary.size(), 1.07);
+		std::uniform_int_distribution<size_t> sentence(4, 24);
+		std::string text;
+		while (text.size() < len) {
+			for (size_t i = sentence(rng); i > 0 && text.size() < len; --i) {
+				std::string word = vocabulary[rank(rng)];
+				if (text.empty() || (text.back() == ' ' && text[text.size() - 2] == '.')) {
+					word[0] = static_cast<char>(std::toupper(static_cast<unsigned char>(word[0])));
+				}
+				text += word;
+				text += i == 1 ? ". " : " ";
+			}
+		}
+		text.resize(len);
+		return text;
+	}
+
+	// the most frequent count words of vocabulary followed by two and three
+	// word phrases of them, so that shorter keywords nest inside longer ones
+	inline std::vector<std::string> zipf_dictionary(rng_type& rng, size_t count, const std::vector<std::string>& vocabulary) {
+		zipf_distribution rank(vocabulary.size(), 1.07);
+		std::set<std::string> keywords(vocabulary.begin(), vocabulary.begin() + std::min(count / 2, vocabulary.size()));
+		size_t attempts = 0;
+		while (keywords.size() < count && attempts++ < count * 4) {
+			std::string phrase = vocabulary[rank(rng)] + " " + vocabulary[rank(rng)];
+			if (attempts % 3 == 0) {
+				phrase += " " + vocabulary[rank(rng)];
+			}
+			keywords.insert(phrase);
+		}
+		return std::vector<std::string>(keywords.begin(), keywords.end());
+	}
+
+	// application log lines: timestamp, level, component, request id, client
+	// address and a short message
+	inline std::string log_text(rng_type& rng, size_t len) {
+		static const char* const levels[] = { "DEBUG", "INFO", "INFO", "INFO", "WARN", "ERROR" };
+		static const char* const components[] = { "http", "db.pool", "auth", "cache", "scheduler", "worker" };
+		static const char* const messages[] = {
+			"request completed", "connection reset by peer", "timeout waiting for lock",
+			"cache miss for key", "user login succeeded", "user login failed",
+			"retrying after error", "slow query detected", "job finished", "disk usage high"
+		};
+		std::uniform_int_distribution<size_t> level(0, sizeof(levels) / sizeof(levels[0]) - 1);
+		std::uniform_int_distribution<size_t> component(0, sizeof(components) / sizeof(components[0]) - 1);
+		std::uniform_int_distribution<size_t> message(0, sizeof(messages) / sizeof(messages[0]) - 1);
+		std::uniform_int_distribution<unsigned> octet(1, 254);
+		std::uniform_int_distribution<unsigned> millis(0, 999);
+		std::uniform_int_distribution<uint64_t> request_id;
+		unsigned long long seconds = 1500000000;
+		std::string text;
+		char line[256];
+		while (text.size() < len) {
+			seconds += millis(rng) % 3;
+			std::snprintf(line, sizeof(line), "%llu.%03u %-5s [%s] req=%016llx ip=%u.%u.%u.%u %s\n",
+				seconds, millis(rng), levels[level(rng)], components[component(rng)],
+				static_cast<unsigned long long>(request_id(rng)),
+				octet(rng), octet(rng), octet(rng), octet(rng), messages[message(rng)]);
+			text += line;
+		}
+		text.resize(len);
+		return text;
+	}
+
+	// newline separated URLs
+	inline std::string url_text(rng_type& rng, size_t len) {
+		std::string text;
+		while (text.size() < len) {
+			text += random_url(rng);
+			text += '\n';
+		}
+		text.resize(len);
+		return text;
+	}
+
+	// a DNA sequence with repeated motifs, which real genomes are full of
+	inline std::string dna_text(rng_type& rng, size_t len) {
+		std::vector<std::string> motifs;
+		for (size_t i = 0; i < 64; ++i) {
+			motifs.push_back(random_string(rng, 8 + i % 24, "ACGT"));
+		}
+		std::uniform_int_distribution<size_t> motif(0, motifs.size() - 1);
+		std::uniform_int_distribution<size_t> gap(0, 64);
+		std::string text;
+		while (text.size() < len) {
+			text += random_string(rng, gap(rng), "ACGT");
+			text += motifs[motif(rng)];
+		}
+		text.resize(len);
+		return text;
+	}
+
+	// random bytes interrupted by runs of zeros and by recurring headers, the
+	// way executables and archives look to a signature scanner
+	inline std::string binary_text(rng_type& rng, size_t len) {
+		std::vector<std::string> headers;
+		for (size_t i = 0; i < 16; ++i) {
+			headers.push_back(random_string(rng, 16, alphabet(256)));
+		}
+		std::uniform_int_distribution<size_t> header(0, headers.size() - 1);
+		std::uniform_int_distribution<size_t> block(64, 4096);
+		std::uniform_int_distribution<size_t> zeros(0, 256);
+		std::string text;
+		while (text.size() < len) {
+			text += headers[header(rng)];
+			text += random_string(rng, block(rng), alphabet(256));
+			text.append(zeros(rng), '\0');
+		}
+		text.resize(len);
+		return text;
+	}
+
+	// count distinct substrings of corpus with lengths in [min_len, max_len],
+	// so that a dictionary follows the distribution of the text it scans
+	inline std::vector<std::string> sampled_dictionary(rng_type& rng, const std::string& corpus, size_t count, size_t min_len, size_t max_len) {
+		// no substring is longer than the corpus
+		max_len = std::min(max_len, corpus.size());
+		min_len = std::min(min_len, max_len);
+		if (max_len == 0) {
+			return std::vector<std::string>();
+		}
+		std::uniform_int_distribution<size_t> length(min_len, max_len);
+		std::uniform_int_distribution<size_t> where(0, corpus.size() - max_len);
+		std::set<std::string> keywords;
+		size_t attempts = 0;
+		while (keywords.size() < count && attempts++ < count * 4) {
+			keywords.insert(corpus.substr(where(rng), length(rng)));
+		}
+		return std::vector<std::string>(keywords.begin(), keywords.end());
+	}
+
+	// keywords each followed by its prefixes, suffixes and middles, so that
+	// every match reports several nested ones through the failure links
+	inline std::vector<std::string> nested_dictionary(const std::vector<std::string>& keywords, size_t count) {
+		std::set<std::string> nested;
+		for (const auto& keyword : keywords) {
+			for (size_t len = keyword.size(); len >= 2 && nested.size() < count; len -= 2) {
+				nested.insert(keyword.substr(0, len));
+				nested.insert(keyword.substr(keyword.size() - len));
+				nested.insert(keyword.substr((keyword.size() - len) / 2, len));
+			}
+			if (nested.size() >= count) {
+				break;
+			}
+		}
+		return std::vector<std::string>(nested.begin(), nested.end());
+	}
+
+	// occurrences of every pattern in text, overlapping ones included
+	inline size_t naive_count(const std::string& text, const std::vector<std::string>& patterns) {
+		size_t count = 0;
+		for (const auto& pattern : patterns) {
+			size_t pos = text.find(pattern);
+			while (pos != text.npos) {
+				count++;
+				pos = text.find(pattern, pos + 1);
+			}
+		}
+		return count;
+	}
+
+} // namespace bench
+
+#endif // AHO_CORASICK_BENCH_GENERATORS_HPP
@@ -0,0 +1,158 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "bench.hpp"
+#include "generators.hpp"
+#include "aho_corasick/aho_corasick.hpp"
+
+namespace ac = aho_corasick;
+
+namespace bench {
+
+	namespace {
+
+		typedef std::chrono::steady_clock clock_type;
+
+		// struct corpus
+		struct corpus {
+			const char*              name;
+			std::vector<std::string> texts;
+		};
+
+		corpus word_corpus(rng_type& rng, size_t count) {
+			std::uniform_int_distribution<size_t> length(50, 500);
+			corpus c = { "words", {} };
+			for (size_t i = 0; i < count; ++i) {
+				c.texts.push_back(word_text(rng, length(rng)));
+			}
+			return c;
+		}
+
+		corpus url_corpus(rng_type& rng, size_t count) {
+			std::uniform_int_distribution<size_t> queries(0, 6);
+			corpus c = { "urls", {} };
+			for (size_t i = 0; i < count; ++i) {
+				std::string url = random_url(rng);
+				for (size_t q = queries(rng); q > 0; --q) {
+					url += (q == 1 ? "?" : "&") + random_word(rng) + "=" + random_word(rng);
+				}
+				c.texts.push_back(url);
+			}
+			return c;
+		}
+
+		double percentile(const std::vector<double>& sorted, double p) {
+			size_t rank = static_cast<size_t>(p / 100.0 * (sorted.size() - 1) + 0.5);
+			return sorted[std::min(rank, sorted.size() - 1)];
+		}
+
+		// times every call separately, cycling through the corpus until calls
+		// have been made
+		template<typename F>
+		void run_calls(const options& opts, const corpus& c, const std::string& flags, const char* api, size_t calls, F f) {
+			for (size_t i = 0; i < std::min(calls, c.texts.size()) * opts.warmup; ++i) {
+				do_not_optimize(f(c.texts[i % c.texts.size()]));
+			}
+			std::vector<double> latencies(calls);
+			size_t bytes = 0;
+			size_t allocations = thread_allocations();
+			size_t allocated_bytes = thread_allocated_bytes();
+			for (size_t i = 0; i < calls; ++i) {
+				const auto& text = c.texts[i % c.texts.size()];
+				auto start = clock_type::now();
+				do_not_optimize(f(text));
+				latencies[i] = std::chrono::duration<double, std::nano>(clock_type::now() - start).count();
+				bytes += text.size();
+			}
+			allocations = thread_allocations() - allocations;
+			allocated_bytes = thread_allocated_bytes() - allocated_bytes;
+
+			double total = 0.0;
+			for (double l : latencies) {
+				total += l;
+			}
+			std::sort(latencies.begin(), latencies.end());
+
+			result r("latency", c.name);
+			r.param("calls", calls)
+			 .param("flags", flags)
+			 .param("api", api)
+			 .metric("p50_ns", percentile(latencies, 50))
+			 .metric("p90_ns", percentile(latencies, 90))
+			 .metric("p99_ns", percentile(latencies, 99))
+			 .metric("p99.9_ns", percentile(latencies, 99.9))
+			 .metric("max_ns", latencies.back())
+			 .metric("mean_ns", total / calls)
+			 .metric("ns/byte", total / std::max<size_t>(1, bytes))
+			 .metric("allocs/call", static_cast<double>(allocations) / calls)
+			 .metric("alloc_bytes/call", static_cast<double>(allocated_bytes) / calls);
+			report(r);
+		}
+
+		void run_corpus(const options& opts, const corpus& c, const std::vector<std::string>& keywords, unsigned flags, size_t calls) {
+			ac::trie t;
+			std::string label = "none";
+			if (flags == 1) {
+				t.remove_overlaps();
+				label = "ro";
+			} else if (flags == 2) {
+				t.only_whole_words();
+				label = "ww";
+			}
+			t.build(keywords.begin(), keywords.end());
+
+			run_calls(opts, c, label, "parse_text", calls, [&t](const std::string& text) {
+				return t.parse_text(text).size();
+			});
+			run_calls(opts, c, label, "count_matches", calls, [&t](const std::string& text) {
+				return t.count_matches(text);
+			});
+			run_calls(opts, c, label, "contains_any", calls, [&t](const std::string& text) -> size_t {
+				return t.contains_any(text);
+			});
+			run_calls(opts, c, label, "find_first", calls, [&t](const std::string& text) {
+				return t.find_first(text).get_end();
+			});
+			run_calls(opts, c, label, "tokenise", calls, [&t](const std::string& text) {
+				return t.tokenise(text).size();
+			});
+			run_calls(opts, c, label, "tokenise_view", calls, [&t](const std::string& text) {
+				return t.tokenise_view(text).size();
+			});
+		}
+
+	} // namespace
+
+	int run_latency(const options& opts) {
+		size_t calls = opts.full ? 10000000 : opts.quick ? 20000 : 1000000;
+		rng_type rng(default_seed);
+		auto keywords = word_dictionary(rng, 10000);
+		const corpus corpora[] = { word_corpus(rng, 10000), url_corpus(rng, 10000) };
+		for (const auto& c : corpora) {
+			for (unsigned flags = 0; flags < 3; ++flags) {
+				run_corpus(opts, c, keywords, flags, calls);
+			}
+		}
+		return 0;
+	}
+
+} // namespace bench
@@ -0,0 +1,142 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#ifndef AHO_CORASICK_BENCH_PERF_COUNTERS_HPP
+#define AHO_CORASICK_BENCH_PERF_COUNTERS_HPP
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+	// class perf_counters
+	// hardware event counts for the calling thread and the threads it starts,
+	// read through perf_event_open; events the kernel or the virtual machine
+	// refuses are left out, so on other platforms the set is simply empty
+	class perf_counters {
+	public:
+		typedef std::vector<std::pair<std::string, double>> value_collection;
+
+	private:
+		// struct counter
+		struct counter {
+			std::string name;
+			int         fd;
+		};
+
+		std::vector<counter> d_counters;
+
+	public:
+		perf_counters() {
+#ifdef __linux__
+			const uint64_t l1d_read_miss = PERF_COUNT_HW_CACHE_L1D
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			const uint64_t dtlb_read_miss = PERF_COUNT_HW_CACHE_DTLB
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+			open("cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+			open("instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+			open("branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+			open("l1d_misses", PERF_TYPE_HW_CACHE, l1d_read_miss);
+			open("llc_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+			open("dtlb_misses", PERF_TYPE_HW_CACHE, dtlb_read_miss);
+#endif
+		}
+
+		~perf_counters() {
+#ifdef __linux__
+			for (const auto& c : d_counters) {
+				close(c.fd);
+			}
+#endif
+		}
+
+		perf_counters(const perf_counters&) = delete;
+		perf_counters& operator=(const perf_counters&) = delete;
+
+		bool available() const {
+			return !d_counters.empty();
+		}
+
+		void start() {
+#ifdef __linux__
+			for (const auto& c : d_counters) {
+				ioctl(c.fd, PERF_EVENT_IOC_RESET, 0);
+				ioctl(c.fd, PERF_EVENT_IOC_ENABLE, 0);
+			}
+#endif
+		}
+
+		// the counts since start, scaled up where the kernel had to multiplex
+		// the hardware counters between events
+		value_collection stop() {
+			value_collection values;
+#ifdef __linux__
+			for (const auto& c : d_counters) {
+				ioctl(c.fd, PERF_EVENT_IOC_DISABLE, 0);
+			}
+			for (const auto& c : d_counters) {
+				uint64_t data[3] = { 0, 0, 0 };
+				if (read(c.fd, data, sizeof(data)) != static_cast<ssize_t>(sizeof(data))) {
+					continue;
+				}
+				double value = static_cast<double>(data[0]);
+				if (data[2] != 0 && data[2] < data[1]) {
+					value *= static_cast<double>(data[1]) / data[2];
+				}
+				values.emplace_back(c.name, value);
+			}
+#endif
+			return values;
+		}
+
+	private:
+#ifdef __linux__
+		void open(const char* name, uint32_t type, uint64_t config) {
+			perf_event_attr attr = perf_event_attr();
+			attr.size = sizeof(attr);
+			attr.type = type;
+			attr.config = config;
+			attr.disabled = 1;
+			attr.inherit = 1;
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+			long fd = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+			if (fd >= 0) {
+				d_counters.push_back(counter{ name, static_cast<int>(fd) });
+			}
+		}
+#endif
+	};
+
+} // namespace bench
+
+#endif // AHO_CORASICK_BENCH_PERF_COUNTERS_HPP
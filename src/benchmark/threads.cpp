@@ -0,0 +1,160 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "bench.hpp"
+#include "generators.hpp"
+#include "aho_corasick/aho_corasick.hpp"
+#include <atomic>
+#include <thread>
+
+namespace ac = aho_corasick;
+
+namespace bench {
+
+	namespace {
+
+		// struct thread_tally
+		// per-thread tallies, each written once when its thread has finished
+		// so that neighbouring tallies sharing a cache line cost nothing
+		struct thread_tally {
+			size_t matches = 0;
+			size_t allocations = 0;
+		};
+
+		// struct corpus
+		struct corpus {
+			const char*              name;
+			std::vector<std::string> documents;
+			size_t                   bytes;
+		};
+
+		corpus word_corpus(const char* name, size_t documents, size_t length) {
+			rng_type rng(default_seed + length);
+			corpus c = { name, {}, 0 };
+			for (size_t i = 0; i < documents; ++i) {
+				c.documents.push_back(word_text(rng, length));
+				c.bytes += length;
+			}
+			return c;
+		}
+
+		// scans every document once with num_threads threads taking the next
+		// unclaimed document in turn, returning the matches found
+		template<typename F>
+		size_t scan(const corpus& c, unsigned num_threads, std::vector<thread_tally>& tallies, F f) {
+			std::atomic<size_t> next(0);
+			auto work = [&](unsigned id) {
+				size_t matches = 0;
+				size_t allocations = thread_allocations();
+				for (size_t i = next++; i < c.documents.size(); i = next++) {
+					matches += f(c.documents[i]);
+				}
+				allocations = thread_allocations() - allocations;
+				tallies[id].matches += matches;
+				tallies[id].allocations += allocations;
+			};
+			std::vector<std::thread> threads;
+			for (unsigned id = 1; id < num_threads; ++id) {
+				threads.emplace_back(work, id);
+			}
+			work(0);
+			for (auto& thread : threads) {
+				thread.join();
+			}
+			size_t matches = 0;
+			for (unsigned id = 0; id < num_threads; ++id) {
+				matches += tallies[id].matches;
+			}
+			return matches;
+		}
+
+		template<typename F>
+		void run_scaling(const options& opts, const corpus& c, const char* api, const std::vector<unsigned>& thread_counts, F f) {
+			double single = 0.0;
+			for (unsigned num_threads : thread_counts) {
+				std::vector<thread_tally> tallies(num_threads);
+				size_t matches = 0;
+				auto time = measure(opts, [&]() {
+					for (auto& tally : tallies) {
+						tally = thread_tally();
+					}
+					matches = scan(c, num_threads, tallies, f);
+					return matches;
+				});
+				size_t allocations = 0;
+				for (const auto& tally : tallies) {
+					allocations += tally.allocations;
+				}
+				double rate = c.bytes / std::max(time.median, 1e-12);
+				if (num_threads == thread_counts.front()) {
+					single = rate / num_threads;
+				}
+				result r("threads", c.name);
+				r.param("documents", c.documents.size())
+				 .param("size", bytes_label(c.documents.front().size()))
+				 .param("api", api)
+				 .param("threads", num_threads)
+				 .throughput(time, c.bytes, matches)
+				 .metric("speedup", single > 0 ? rate / single : 0.0)
+				 .metric("efficiency_%", single > 0 ? 100.0 * rate / single / num_threads : 0.0)
+				 .metric("allocs/doc", static_cast<double>(allocations) / c.documents.size());
+				report(r);
+			}
+		}
+
+	} // namespace
+
+	int run_threads(const options& opts) {
+		unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+		std::vector<unsigned> thread_counts;
+		for (unsigned n = 1; n < hardware; n *= 2) {
+			thread_counts.push_back(n);
+		}
+		thread_counts.push_back(hardware);
+		if (hardware == 1) {
+			// still exercise the shared paths, oversubscribed
+			thread_counts.push_back(2);
+		}
+
+		rng_type rng(default_seed);
+		auto keywords = word_dictionary(rng, opts.quick ? 10000 : 100000);
+		ac::trie t;
+		t.build(keywords.begin(), keywords.end());
+
+		size_t scale = opts.full ? 4 : 1;
+		size_t shrink = opts.quick ? 16 : 1;
+		const corpus corpora[] = {
+			word_corpus("large", 256 * scale / shrink, 64 << 10),
+			word_corpus("small", 65536 * scale / shrink, 256),
+		};
+		for (const auto& c : corpora) {
+			run_scaling(opts, c, "count_matches", thread_counts, [&t](const std::string& text) {
+				return t.count_matches(text);
+			});
+			run_scaling(opts, c, "parse_text", thread_counts, [&t](const std::string& text) {
+				return t.parse_text(text).size();
+			});
+		}
+		return 0;
+	}
+
+} // namespace bench
@@ -0,0 +1,250 @@
+/*
+* Copyright (C) 2015 Christopher Gilbert.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a copy
+* of this software and associated documentation files (the "Software"), to deal
+* in the Software without restriction, including without limitation the rights
+* to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+* copies of the Software, and to permit persons to whom the Software is
+* furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in all
+* copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+* AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+* OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+* SOFTWARE.
+*/
+
+#include "bench.hpp"
+#include "generators.hpp"
+#include "aho_corasick/aho_corasick.hpp"
+
+namespace ac = aho_corasick;
+
+namespace bench {
+
+	namespace {
+
+		enum flag_bits {
+			case_insensitive = 1,
+			remove_overlaps  = 2,
+			whole_words      = 4
+		};
+
+		// struct workload
+		struct workload {
+			size_t   dictionary_size = 10000;
+			size_t   min_length = 4;
+			size_t   max_length = 12;
+			size_t   alphabet_size = 26;
+			size_t   text_size = 1 << 20;
+			double   density = 0.01;
+			unsigned flags = 0;
+			bool     parse = false;
+		};
+
+		std::string flags_label(unsigned flags) {
+			if (flags == 0) {
+				return "none";
+			}
+			std::string label;
+			if (flags & case_insensitive) {
+				label += "+ci";
+			}
+			if (flags & remove_overlaps) {
+				label += "+ro";
+			}
+			if (flags & whole_words) {
+				label += "+ww";
+			}
+			return label.substr(1);
+		}
+
+		void configure(ac::trie& t, unsigned flags) {
+			if (flags & case_insensitive) {
+				t.case_insensitive();
+			}
+			if (flags & remove_overlaps) {
+				t.remove_overlaps();
+			}
+			if (flags & whole_words) {
+				t.only_whole_words();
+			}
+		}
+
+		void run_workload(const options& opts, const std::string& sweep, const workload& w) {
+			rng_type rng(default_seed);
+			auto chars = alphabet(w.alphabet_size);
+			auto keywords = random_dictionary(rng, w.dictionary_size, w.min_length, w.max_length, chars);
+			auto text = planted_text(rng, w.text_size, keywords, w.density, chars);
+
+			ac::trie t;
+			configure(t, w.flags);
+			t.build(keywords.begin(), keywords.end());
+
+			size_t matches = w.parse ? t.parse_text(text).size() : t.count_matches(text);
+			auto time = measure(opts, [&]() -> size_t {
+				return w.parse ? t.parse_text(text).size() : t.count_matches(text);
+			});
+
+			result r("throughput", sweep);
+			r.param("keywords", keywords.size())
+			 .param("length", std::to_string(w.min_length) + "-" + std::to_string(w.max_length))
+			 .param("alphabet", chars.size())
+			 .param("text", bytes_label(w.text_size))
+			 .param("density", w.density)
+			 .param("flags", flags_label(w.flags))
+			 .param("api", w.parse ? "parse_text" : "count_matches")
+			 .throughput(time, text.size(), matches);
+			report(r);
+		}
+
+		// a dictionary scanned over text drawn from the same source
+		void run_corpus(const options& opts, const char* name, const std::string& text, const std::vector<std::string>& keywords) {
+			ac::trie t;
+			t.build(keywords.begin(), keywords.end());
+			size_t matches = t.count_matches(text);
+			auto time = measure(opts, [&]() { return t.count_matches(text); });
+
+			result r("throughput", "corpus");
+			r.param("corpus", name)
+			 .param("keywords", keywords.size())
+			 .param("text", bytes_label(text.size()))
+			 .throughput(time, text.size(), matches);
+			report(r);
+		}
+
+		void run_corpora(const options& opts, size_t text_size) {
+			const size_t count = 10000;
+			rng_type rng(default_seed);
+			auto vocabulary = ranked_vocabulary(rng, 50000);
+			auto prose = zipf_text(rng, text_size, vocabulary);
+			run_corpus(opts, "zipf-words", prose, zipf_dictionary(rng, count, vocabulary));
+			run_corpus(opts, "zipf-nested", prose, nested_dictionary(zipf_dictionary(rng, count, vocabulary), count));
+
+			auto logs = log_text(rng, text_size);
+			run_corpus(opts, "logs", logs, sampled_dictionary(rng, logs, count, 4, 16));
+
+			auto urls = url_text(rng, text_size);
+			auto url_keywords = sampled_dictionary(rng, urls, count, 6, 24);
+			run_corpus(opts, "urls", urls, url_keywords);
+			run_corpus(opts, "urls-nested", urls, nested_dictionary(url_keywords, count));
+
+			auto dna = dna_text(rng, text_size);
+			run_corpus(opts, "dna", dna, sampled_dictionary(rng, dna, count, 8, 32));
+
+			auto binary = binary_text(rng, text_size);
+			run_corpus(opts, "binary", binary, sampled_dictionary(rng, binary, count, 4, 16));
+		}
+
+		// checks the automaton against repeated string::find on dictionaries
+		// small enough for the naive search to finish
+		bool run_naive(const options& opts, size_t dictionary_size, size_t text_size) {
+			rng_type rng(default_seed);
+			auto chars = alphabet(26);
+			auto keywords = random_dictionary(rng, dictionary_size, 4, 12, chars);
+			auto text = planted_text(rng, text_size, keywords, 0.01, chars);
+
+			ac::trie t;
+			t.build(keywords.begin(), keywords.end());
+			size_t expected = naive_count(text, keywords);
+			size_t matches = t.count_matches(text);
+
+			auto naive_time = measure(opts, [&]() { return naive_count(text, keywords); });
+			auto ac_time = measure(opts, [&]() { return t.count_matches(text); });
+
+			for (int naive = 1; naive >= 0; --naive) {
+				result r("throughput", naive ? "naive-find" : "naive-ac");
+				r.param("keywords", keywords.size())
+				 .param("text", bytes_label(text_size))
+				 .throughput(naive ? naive_time : ac_time, text.size(), naive ? expected : matches);
+				report(r);
+			}
+			if (matches != expected) {
+				std::cerr << "count mismatch: naive " << expected << ", aho-corasick " << matches << std::endl;
+				return false;
+			}
+			return true;
+		}
+
+	} // namespace
+
+	int run_throughput(const options& opts) {
+		workload base;
+		if (opts.quick) {
+			base.text_size = 64 << 10;
+		}
+
+		std::vector<size_t> dictionary_sizes = { 10, 100, 1000, 10000, 100000 };
+		if (opts.full) {
+			dictionary_sizes.push_back(1000000);
+			dictionary_sizes.push_back(10000000);
+		} else if (opts.quick) {
+			dictionary_sizes.pop_back();
+		}
+		for (size_t size : dictionary_sizes) {
+			workload w = base;
+			w.dictionary_size = size;
+			run_workload(opts, "dictionary", w);
+		}
+
+		const std::pair<size_t, size_t> lengths[] = { {2, 2}, {4, 4}, {8, 8}, {16, 16}, {32, 32}, {2, 64} };
+		for (const auto& length : lengths) {
+			workload w = base;
+			w.min_length = length.first;
+			w.max_length = length.second;
+			run_workload(opts, "length", w);
+		}
+
+		for (size_t size : { 2, 4, 26, 62, 256 }) {
+			workload w = base;
+			w.alphabet_size = size;
+			run_workload(opts, "alphabet", w);
+		}
+
+		std::vector<size_t> text_sizes = { 1 << 10, 64 << 10, 1 << 20, 16 << 20 };
+		if (opts.full) {
+			text_sizes.push_back(64 << 20);
+		} else if (opts.quick) {
+			text_sizes.pop_back();
+		}
+		for (size_t size : text_sizes) {
+			workload w = base;
+			w.text_size = size;
+			run_workload(opts, "text", w);
+		}
+
+		for (double density : { 0.0, 0.001, 0.01, 0.1, 0.5 }) {
+			workload w = base;
+			w.density = density;
+			run_workload(opts, "density", w);
+		}
+
+		const unsigned flag_sets[] = {
+			0, case_insensitive, remove_overlaps, whole_words,
+			case_insensitive | remove_overlaps | whole_words
+		};
+		for (unsigned flags : flag_sets) {
+			for (bool parse : { false, true }) {
+				workload w = base;
+				w.flags = flags;
+				w.parse = parse;
+				run_workload(opts, "flags", w);
+			}
+		}
+
+		run_corpora(opts, base.text_size);
+
+		bool ok = true;
+		for (size_t size : { 10, 100, 1000 }) {
+			ok = run_naive(opts, size, base.text_size) && ok;
+		}
+		return ok ? 0 : 1;
+	}
+
+} // namespace bench
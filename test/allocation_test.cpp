@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 Christopher Gilbert.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define CATCH_CONFIG_MAIN
+#include "../test/catch.hpp"
+
+#include "aho_corasick/aho_corasick.hpp"
+#include "benchmark/allocations.hpp"
+#include <string>
+#include <vector>
+
+namespace ac = aho_corasick;
+
+namespace {
+
+	// the allocations made while f runs
+	template<typename F>
+	size_t allocations_in(F f) {
+		size_t before = bench::thread_allocations();
+		f();
+		return bench::thread_allocations() - before;
+	}
+
+} // namespace
+
+TEST_CASE("scans allocate as required", "[allocation]") {
+	const std::string text = "she sells seashells by the seashore, he says; his shells are hers";
+	ac::trie t;
+	t.insert("hers");
+	t.insert("his");
+	t.insert("she");
+	t.insert("he");
+	t.insert("shells");
+	SECTION("scan hot path") {
+		t.build();
+		size_t count = 0;
+		bool found = false;
+		ac::trie::emit_type first;
+		REQUIRE(0 == allocations_in([&]() { count = t.count_matches(text); }));
+		REQUIRE(0 == allocations_in([&]() { found = t.contains_any(text); }));
+		// keywords this short are held inline by the emit's string
+		REQUIRE(0 == allocations_in([&]() { first = t.find_first(text); }));
+		REQUIRE(13 == count);
+		REQUIRE(found);
+		REQUIRE(1 == first.get_start());
+	}
+	SECTION("counting into presized tallies") {
+		t.build();
+		ac::keyword_histogram histogram(t.stats().num_keywords);
+		std::vector<size_t> counts(t.stats().num_keywords, 0);
+		REQUIRE(0 == allocations_in([&]() { t.count_matches(text, counts); }));
+		REQUIRE(0 == allocations_in([&]() { t.count_keywords(text, histogram); }));
+		REQUIRE(histogram.total() == 13);
+	}
+	SECTION("tokenising into a sink") {
+		t.build();
+		size_t tokens = 0;
+		REQUIRE(0 == allocations_in([&]() {
+			t.tokenise(text, [&tokens](const ac::trie::token_view_type&) { ++tokens; });
+		}));
+		REQUIRE(tokens > 0);
+	}
+	SECTION("configured scans") {
+		ac::trie u;
+		u.case_insensitive().only_whole_words().utf8();
+		u.insert("Straße");
+		u.insert("shells");
+		u.build();
+		const std::string mixed = "SHELLS in der STRASSE und straße";
+		size_t count = 0;
+		REQUIRE(0 == allocations_in([&]() { count = u.count_matches(mixed); }));
+		REQUIRE(2 == count);
+	}
+	SECTION("collecting calls") {
+		t.build();
+		ac::trie::emit_collection emits;
+		size_t parse = allocations_in([&]() { emits = t.parse_text(text); });
+		// only the result grows, the emits themselves do not allocate
+		REQUIRE(13 == emits.size());
+		REQUIRE(parse < emits.size());
+		REQUIRE(parse > 0);
+	}
+	SECTION("building") {
+		// linking takes the queue and one node for each emit copied along a
+		// failure link, as these keywords are short enough to be held inline
+		const size_t emits = t.stats().num_emits;
+		size_t build = allocations_in([&]() { t.build(); });
+		REQUIRE(1 + t.stats().num_emits - emits == build);
+		REQUIRE(0 == allocations_in([&]() { t.build(); }));
+	}
+}
+
+TEST_CASE("bulk insert allocates as required", "[allocation]") {
+	// every string distinct, and short enough to be held inline
+	std::vector<std::string> keywords;
+	for (char a = 'a'; a <= 'z'; ++a) {
+		for (char b = 'a'; b <= 'z'; ++b) {
+			for (char c = 'a'; c <= 'z'; c += 5) {
+				keywords.push_back(std::string(1, a) + b + c + "xyz");
+			}
+		}
+	}
+	SECTION("transitions come from the reserved arena") {
+		ac::trie t;
+		size_t insert = allocations_in([&]() { t.insert(keywords.begin(), keywords.end()); });
+		const auto stats = t.stats();
+		REQUIRE(keywords.size() * 4 < stats.num_transitions);
+		// one emit node per keyword, the root's own transitions, and a handful
+		// for the sort and the arena block, but none per transition below
+		REQUIRE(insert <= keywords.size() + 26 + 16);
+	}
+}
@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2018 Christopher Gilbert.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#define CATCH_CONFIG_MAIN
+#include "../test/catch.hpp"
+
+// AHO_CORASICK_INSTRUMENT is defined for this target by test/CMakeLists.txt
+#include "aho_corasick/aho_corasick.hpp"
+
+namespace ac = aho_corasick;
+
+TEST_CASE("instrumentation works as required", "[instrumentation]") {
+	auto& counters = ac::thread_scan_counters();
+	counters.reset();
+	SECTION("scan counters") {
+		ac::trie t;
+		t.insert("hers");
+		t.insert("his");
+		t.insert("she");
+		t.insert("he");
+
+		REQUIRE(3 == t.parse_text("ushers").size());
+		REQUIRE(6 == counters.bytes_scanned);
+		REQUIRE(3 == counters.emits);
+		REQUIRE(1 == counters.root_visits);
+		REQUIRE(1 == counters.failure_hops);
+		REQUIRE(0 == counters.partial_matches_rejected);
+	}
+	SECTION("post-pass counters") {
+		ac::trie t;
+		t.remove_overlaps().only_whole_words();
+		t.insert("sugar");
+		t.insert("sugar cane");
+		t.insert("cane");
+
+		REQUIRE(1 == t.parse_text("sugar cane canesugar").size());
+		REQUIRE(2 == counters.partial_matches_rejected);
+		REQUIRE(2 == counters.overlaps_removed);
+	}
+}
@@ -24,6 +24,8 @@
 #include "../test/catch.hpp"
 
 #include "aho_corasick/aho_corasick.hpp"
+#include <algorithm>
+#include <random>
 #include <vector>
 
 namespace ac = aho_corasick;
@@ -63,4 +65,91 @@ TEST_CASE("interval_tree works as required", "[interval_tree]") {
 		const auto result = tree.remove_overlaps(intervals);
 		REQUIRE(2 == result.size());
 	}
-}
\ No newline at end of file
+}
+
+TEST_CASE("flat_interval_tree works as required", "[flat_interval_tree]") {
+	SECTION("find overlaps") {
+		const std::vector<ac::interval> intervals {
+			ac::interval(5, 7),
+			ac::interval(0, 2),
+			ac::interval(3, 5),
+			ac::interval(1, 3),
+			ac::interval(4, 6),
+			ac::interval(2, 4),
+		};
+		ac::flat_interval_tree<ac::interval> tree(intervals);
+		std::vector<size_t> overlaps;
+		tree.find_overlaps(ac::interval(1, 3), overlaps);
+		REQUIRE(4 == overlaps.size());
+		std::sort(overlaps.begin(), overlaps.end());
+		REQUIRE(0 == tree[overlaps[0]].get_start());
+		REQUIRE(1 == tree[overlaps[1]].get_start());
+		REQUIRE(2 == tree[overlaps[2]].get_start());
+		REQUIRE(3 == tree[overlaps[3]].get_start());
+	}
+	SECTION("find overlaps agrees with a linear search") {
+		std::mt19937 rng(42);
+		std::vector<ac::interval> intervals;
+		for (size_t i = 0; i < 1000; ++i) {
+			size_t start = rng() % 5000;
+			intervals.push_back(ac::interval(start, start + rng() % 40));
+		}
+		ac::flat_interval_tree<ac::interval> tree(intervals);
+		std::vector<size_t> overlaps;
+		for (size_t q = 0; q < 200; ++q) {
+			size_t start = rng() % 5000;
+			ac::interval query(start, start + rng() % 100);
+			overlaps.clear();
+			tree.find_overlaps(query, overlaps);
+			size_t expected = std::count_if(intervals.begin(), intervals.end(), [&query](const ac::interval& i) {
+				return i.overlaps_with(query);
+			});
+			REQUIRE(expected == overlaps.size());
+			for (auto i : overlaps) {
+				REQUIRE(tree[i].overlaps_with(query));
+			}
+		}
+	}
+	SECTION("remove overlaps") {
+		const std::vector<ac::interval> intervals {
+			ac::interval(0, 2),
+			ac::interval(4, 5),
+			ac::interval(2, 10),
+			ac::interval(6, 13),
+			ac::interval(9, 15),
+			ac::interval(12, 16),
+		};
+		ac::flat_interval_tree<ac::interval> tree(intervals);
+		const auto result = tree.remove_overlaps();
+		REQUIRE(2 == result.size());
+		REQUIRE(2 == result[0].get_start());
+		REQUIRE(12 == result[1].get_start());
+	}
+	SECTION("remove overlaps with shared starts") {
+		const std::vector<ac::interval> intervals {
+			ac::interval(0, 4),
+			ac::interval(3, 9),
+			ac::interval(3, 5),
+			ac::interval(5, 6),
+		};
+		ac::flat_interval_tree<ac::interval> tree(intervals);
+		const auto result = tree.remove_overlaps();
+		REQUIRE(1 == result.size());
+		REQUIRE(3 == result[0].get_start());
+		REQUIRE(9 == result[0].get_end());
+	}
+	SECTION("remove overlaps prefers the leftmost of equal lengths") {
+		const std::vector<ac::interval> intervals {
+			ac::interval(1, 2),
+			ac::interval(0, 1),
+			ac::interval(3, 4),
+			ac::interval(3, 4),
+		};
+		ac::flat_interval_tree<ac::interval> tree(intervals);
+		const auto result = tree.remove_overlaps();
+		REQUIRE(3 == result.size());
+		REQUIRE(0 == result[0].get_start());
+		REQUIRE(3 == result[1].get_start());
+		REQUIRE(3 == result[2].get_start());
+	}
+}
@@ -24,7 +24,11 @@
 #include "../test/catch.hpp"
 
 #include "aho_corasick/aho_corasick.hpp"
+#include <random>
+#include <set>
+#include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace ac = aho_corasick;
 
@@ -140,6 +144,134 @@ TEST_CASE("trie works as required", "[trie]") {
 		check_emit(*it++, 0, 4, "ababc");
 		check_emit(*it++, 6, 7, "ab");
 	}
+	SECTION("non overlapping prefers the leftmost of equal lengths") {
+		ac::trie t;
+		t.remove_overlaps();
+		t.insert("bc");
+		t.insert("ab");
+
+		auto emits = t.parse_text("abc");
+		REQUIRE(1 == emits.size());
+		check_emit(emits[0], 0, 1, "ab");
+	}
+	SECTION("non overlapping keeps matches sharing a span") {
+		ac::trie t;
+		t.remove_overlaps().case_insensitive();
+		t.insert("she");
+		t.insert("HE");
+		t.insert("he");
+		t.insert("he");
+
+		auto emits = t.parse_text("she he");
+		REQUIRE(4 == emits.size());
+		check_emit(emits[0], 0, 2, "she");
+		REQUIRE(emits[1].get_index() < emits[2].get_index());
+		REQUIRE(emits[2].get_index() < emits[3].get_index());
+		for (size_t i = 1; i < 4; ++i) {
+			REQUIRE(4 == emits[i].get_start());
+			REQUIRE(5 == emits[i].get_end());
+		}
+	}
+	SECTION("count matches") {
+		ac::trie t;
+		t.insert("he");
+		t.insert("hehehehe");
+
+		REQUIRE(7 == t.count_matches("hehehehehe"));
+
+		std::vector<size_t> counts;
+		REQUIRE(7 == t.count_matches("hehehehehe", counts));
+		REQUIRE(2 == counts.size());
+		REQUIRE(5 == counts[0]);
+		REQUIRE(2 == counts[1]);
+	}
+	SECTION("count matches honours the configuration") {
+		ac::trie t;
+		t.remove_overlaps().only_whole_words();
+		t.insert("ab");
+		t.insert("cba");
+		t.insert("ababc");
+
+		const std::string text("ababcbab ab cba, ababc");
+		REQUIRE(t.parse_text(text).size() == t.count_matches(text));
+		std::vector<size_t> counts;
+		REQUIRE(3 == t.count_matches(text, counts));
+		REQUIRE(1 == counts[0]);
+		REQUIRE(1 == counts[1]);
+		REQUIRE(1 == counts[2]);
+	}
+	SECTION("contains any") {
+		ac::trie t;
+		t.only_whole_words();
+		t.insert("sugar");
+
+		REQUIRE(!t.contains_any("sugarcane canesugar"));
+		REQUIRE(t.contains_any("sugarcane sugar"));
+		REQUIRE(!t.contains_any(""));
+	}
+	SECTION("find first") {
+		ac::trie t;
+		t.insert("hers");
+		t.insert("his");
+		t.insert("she");
+
+		check_emit(t.find_first("ushers and his"), 1, 3, "she");
+		REQUIRE(t.find_first("nothing here").is_empty());
+	}
+	SECTION("matched keywords") {
+		ac::trie t;
+		t.insert("he");
+		t.insert("she");
+		t.insert("his");
+		t.insert("hers");
+
+		auto found = t.matched_keywords("ushers he she");
+		REQUIRE(3 == found.size());
+		REQUIRE(0 == found[0]);
+		REQUIRE(1 == found[1]);
+		REQUIRE(3 == found[2]);
+
+		found = t.matched_keywords("ushers he she", { 2, 3 });
+		REQUIRE(1 == found.size());
+		REQUIRE(3 == found[0]);
+	}
+	SECTION("keyword set") {
+		ac::keyword_set dense(100, 10);
+		ac::keyword_set sparse(1000000, 10);
+		for (unsigned i : { 7, 3, 7, 99, 3 }) {
+			dense.insert(i);
+			sparse.insert(i);
+		}
+		const std::vector<unsigned> expected { 3, 7, 99 };
+		REQUIRE(expected == dense.get_members());
+		REQUIRE(expected == sparse.get_members());
+	}
+	SECTION("keyword histogram") {
+		ac::trie t;
+		t.insert("he");
+		t.insert("she");
+		t.insert("his");
+		t.insert("hers");
+
+		std::vector<std::string> documents;
+		for (size_t i = 0; i < 100; ++i) {
+			documents.push_back(i % 2 ? "ushers" : "his hat");
+		}
+		auto histogram = t.count_keywords(documents.begin(), documents.end(), 4);
+		REQUIRE(50 == histogram.get_count(0));
+		REQUIRE(50 == histogram.get_count(1));
+		REQUIRE(50 == histogram.get_count(2));
+		REQUIRE(50 == histogram.get_count(3));
+		REQUIRE(200 == histogram.total());
+
+		t.count_keywords("he he", histogram);
+		auto top = histogram.top(2);
+		REQUIRE(2 == top.size());
+		REQUIRE(0 == top[0].first);
+		REQUIRE(52 == top[0].second);
+		REQUIRE(1 == top[1].first);
+		REQUIRE(50 == top[1].second);
+	}
 	SECTION("partial match") {
 		ac::trie t;
 		t.only_whole_words();
@@ -151,6 +283,30 @@ TEST_CASE("trie works as required", "[trie]") {
 		const auto it = emits.begin();
 		check_emit(*it, 20, 24, "sugar");
 	}
+	SECTION("partial match with configured word characters") {
+		ac::trie t;
+		t.only_whole_words().word_characters("0123456789_");
+		t.insert("sugar");
+
+		auto emits = t.parse_text("sugar_cane sugar2 (sugar) 1sugar");
+		REQUIRE(1 == emits.size());
+
+		const auto it = emits.begin();
+		check_emit(*it, 19, 23, "sugar");
+	}
+	SECTION("whole words at text boundaries") {
+		ac::trie t;
+		t.only_whole_words();
+		t.insert("he");
+		t.insert("she");
+
+		auto emits = t.parse_text("she he");
+		REQUIRE(2 == emits.size());
+
+		auto it = emits.begin();
+		check_emit(*it++, 0, 2, "she");
+		check_emit(*it++, 4, 5, "he");
+	}
 	SECTION("tokenise tokens in sequence") {
 		ac::trie t;
 		t.insert("Alpha");
@@ -179,6 +335,62 @@ TEST_CASE("trie works as required", "[trie]") {
 		check_token(*it++, "Gamma");
 		check_token(*it++, " in reserve");
 	}
+	SECTION("tokenise views into the text") {
+		ac::trie t;
+		t.only_whole_words();
+		t.insert("Alpha");
+		t.insert("Beta");
+		t.insert("Gamma");
+
+		const std::string text("Hear: Alpha team first, Beta from the rear, Gamma in reserve");
+		auto tokens = t.tokenise_view(text);
+		REQUIRE(7 == tokens.size());
+
+		auto it = tokens.begin();
+		REQUIRE(!it->is_match());
+		REQUIRE(text.data() == it->data());
+		REQUIRE("Hear: " == it->get_fragment());
+		++it;
+		REQUIRE(it->is_match());
+		REQUIRE(0 == it->get_index());
+		REQUIRE(6 == it->get_start());
+		REQUIRE(5 == it->size());
+		++it;
+		REQUIRE(" team first, " == (it++)->get_fragment());
+		REQUIRE(1 == (it++)->get_index());
+		REQUIRE(" from the rear, " == (it++)->get_fragment());
+		REQUIRE(2 == (it++)->get_index());
+		REQUIRE(" in reserve" == (it++)->get_fragment());
+	}
+	SECTION("tokenise into a sink") {
+		ac::trie t;
+		t.remove_overlaps();
+		t.insert("hot");
+		t.insert("hot chocolate");
+
+		std::string html;
+		t.tokenise("a hot chocolate or a hot tea", [&html](const ac::trie::token_view_type& tok) {
+			if (tok.is_match()) html += "<i>";
+			html.append(tok.data(), tok.size());
+			if (tok.is_match()) html += "</i>";
+		});
+		REQUIRE("a <i>hot chocolate</i> or a <i>hot</i> tea" == html);
+	}
+	SECTION("tokenise into a sink skips overlapping matches") {
+		ac::trie t;
+		t.insert("hers");
+		t.insert("his");
+		t.insert("she");
+		t.insert("he");
+
+		std::string html;
+		t.tokenise("ushers", [&html](const ac::trie::token_view_type& tok) {
+			if (tok.is_match()) html += "<i>";
+			html.append(tok.data(), tok.size());
+			if (tok.is_match()) html += "</i>";
+		});
+		REQUIRE("u<i>she</i>rs" == html);
+	}
 	SECTION("wtrie case insensitive") {
 		ac::wtrie t;
 		t.case_insensitive().only_whole_words();
@@ -209,6 +421,305 @@ TEST_CASE("trie works as required", "[trie]") {
 		check_emit(*it++, 8, 11, "once");
 		check_emit(*it++, 13, 17, "again");
 	}
+	SECTION("trie case insensitive keywords") {
+		ac::trie t;
+		t.case_insensitive();
+		t.insert("TurNing");
+		t.insert("ONCE");
+
+		auto emits = t.parse_text("turning once AGAIN");
+		REQUIRE(2 == emits.size());
+
+		auto it = emits.begin();
+		check_emit(*it++, 0, 6, "TurNing");
+		check_emit(*it++, 8, 11, "ONCE");
+	}
+	SECTION("case folding leaves non-letters alone") {
+		ac::case_folding<char> fold;
+		REQUIRE(std::string("abc-xyz@[`{\xc9") == fold(std::string("AbC-XyZ@[`{\xc9")));
+	}
+	SECTION("wtrie unicode case insensitive") {
+		ac::wtrie t;
+		t.case_insensitive();
+		t.insert(L"ΣΟΦΊΑ");
+		t.insert(L"москва");
+		t.insert(L"Ärger");
+
+		auto emits = t.parse_text(L"σοφία, МОСКВА, äRGER");
+		REQUIRE(3 == emits.size());
+
+		auto it = emits.begin();
+		check_wemit(*it++, 0, 4, L"ΣΟΦΊΑ");
+		check_wemit(*it++, 7, 12, L"москва");
+		check_wemit(*it++, 15, 19, L"Ärger");
+	}
+	SECTION("trie utf-8 case insensitive") {
+		ac::trie t;
+		t.case_insensitive();
+		t.insert(u8"école");
+		t.insert(u8"ΣΟΦΊΑ");
+
+		auto emits = t.parse_text(u8"L'ÉCOLE de σοφία");
+		REQUIRE(2 == emits.size());
+
+		auto it = emits.begin();
+		check_emit(*it++, 2, 7, u8"école");
+		check_emit(*it++, 12, 21, u8"ΣΟΦΊΑ");
+	}
+	SECTION("utf-8 folding preserves sequence length") {
+		ac::case_folding<char> fold;
+		// the kelvin sign folds to an ascii k, which would shift the offsets
+		REQUIRE(std::string(u8"\u212a\u00e9\u00e9") == fold(std::string(u8"\u212a\u00c9\u00e9")));
+		REQUIRE(std::string("\xc3(\xff") == fold(std::string("\xc3(\xff")));
+	}
+	SECTION("utf-8 whole words and code point offsets") {
+		ac::trie t;
+		t.utf8().only_whole_words();
+		t.insert(u8"caf");
+		t.insert(u8"café");
+
+		auto emits = t.parse_text(u8"naïve café, caf");
+		REQUIRE(2 == emits.size());
+
+		auto it = emits.begin();
+		check_emit(*it, 7, 11, u8"café");
+		REQUIRE(6 == it->get_code_point_start());
+		REQUIRE(9 == it->get_code_point_end());
+		++it;
+		check_emit(*it, 14, 16, u8"caf");
+		REQUIRE(12 == it->get_code_point_start());
+		REQUIRE(14 == it->get_code_point_end());
+	}
+	SECTION("wtrie whole words on non-ascii letters") {
+		ac::wtrie t;
+		t.only_whole_words();
+		t.insert(L"caf");
+
+		auto emits = t.parse_text(L"café caf");
+		REQUIRE(1 == emits.size());
+		check_wemit(*emits.begin(), 5, 7, L"caf");
+	}
+	SECTION("bulk insert matches incremental insert") {
+		const std::vector<std::string> keywords { "hers", "his", "she", "he", "", "hi", "she", "ushers" };
+		ac::trie one_by_one;
+		for (const auto& k : keywords) {
+			one_by_one.insert(k);
+		}
+		ac::trie bulk;
+		bulk.build(keywords.begin(), keywords.end());
+
+		const std::string text("ushers and his hi-fi, she said");
+		auto expected = one_by_one.parse_text(text);
+		auto emits = bulk.parse_text(text);
+		REQUIRE(expected.size() == emits.size());
+		for (size_t i = 0; i < emits.size(); ++i) {
+			check_emit(emits[i], expected[i].get_start(), expected[i].get_end(), expected[i].get_keyword());
+			REQUIRE(expected[i].get_index() == emits[i].get_index());
+		}
+	}
+	SECTION("bulk insert from a range of literals") {
+		const char* keywords[] = { "hers", "", "he", "ushers" };
+		ac::trie t;
+		t.build(std::begin(keywords), std::end(keywords));
+
+		auto emits = t.parse_text("ushers");
+		REQUIRE(3 == emits.size());
+		check_emit(emits[0], 2, 3, "he");
+		REQUIRE(1 == emits[0].get_index());
+		check_emit(emits[1], 2, 5, "hers");
+		REQUIRE(0 == emits[1].get_index());
+		check_emit(emits[2], 0, 5, "ushers");
+		REQUIRE(2 == emits[2].get_index());
+	}
+	SECTION("bulk insert into a populated trie") {
+		ac::trie t;
+		t.case_insensitive();
+		t.insert("hers");
+		const std::vector<std::string> keywords { "HE", "hErS", "Ushers" };
+		t.insert(keywords.begin(), keywords.end());
+
+		auto emits = t.parse_text("USHERS");
+		REQUIRE(4 == emits.size());
+
+		auto it = emits.begin();
+		check_emit(*it, 2, 3, "HE");
+		REQUIRE(1 == (it++)->get_index());
+		check_emit(*it, 0, 5, "Ushers");
+		REQUIRE(3 == (it++)->get_index());
+		check_emit(*it, 2, 5, "hErS");
+		REQUIRE(2 == (it++)->get_index());
+		check_emit(*it, 2, 5, "hers");
+		REQUIRE(0 == (it++)->get_index());
+	}
+	SECTION("bulk insert ahead of existing transitions") {
+		const std::vector<std::string> keywords { "ha", "a", "hb" };
+		ac::trie one_by_one;
+		ac::trie t;
+		for (const auto& k : { "hz", "z" }) {
+			one_by_one.insert(k);
+			t.insert(k);
+		}
+		for (const auto& k : keywords) {
+			one_by_one.insert(k);
+		}
+		t.insert(keywords.begin(), keywords.end(), 2);
+
+		const std::string text("hahbhza");
+		auto expected = one_by_one.parse_text(text);
+		auto emits = t.parse_text(text);
+		REQUIRE(6 == emits.size());
+		REQUIRE(expected.size() == emits.size());
+		for (size_t i = 0; i < emits.size(); ++i) {
+			check_emit(emits[i], expected[i].get_start(), expected[i].get_end(), expected[i].get_keyword());
+			REQUIRE(expected[i].get_index() == emits[i].get_index());
+		}
+
+		t = ac::trie();
+		t.insert(keywords.begin(), keywords.end());
+		REQUIRE(3 == t.parse_text("hahb").size());
+	}
+	SECTION("parallel build matches serial build") {
+		std::mt19937 rng(7);
+		const auto random_string = [&rng](size_t length) -> std::string {
+			std::string result;
+			for (size_t i = 0; i < length; ++i) {
+				result += static_cast<char>('a' + rng() % 4);
+			}
+			return result;
+		};
+		std::set<std::string> keywords;
+		while (keywords.size() < 20000) {
+			keywords.insert(random_string(1 + rng() % 12));
+		}
+		ac::trie serial;
+		serial.insert("dcba");
+		serial.build(keywords.begin(), keywords.end());
+		ac::trie parallel;
+		parallel.insert("dcba");
+		parallel.build(keywords.begin(), keywords.end(), 4);
+
+		const std::string text(random_string(500));
+		const auto flatten = [](const ac::trie::emit_collection& emits) -> std::vector<size_t> {
+			std::vector<size_t> result;
+			for (const auto& e : emits) {
+				result.push_back(e.get_start());
+				result.push_back(e.get_end());
+				result.push_back(e.get_index());
+			}
+			return result;
+		};
+		REQUIRE(flatten(serial.parse_text(text)) == flatten(parallel.parse_text(text)));
+	}
+	SECTION("stats") {
+		ac::trie t;
+		t.insert("hers");
+		t.insert("his");
+		t.insert("she");
+		t.insert("he");
+		t.insert("a keyword too long to be stored inline");
+
+		auto stats = t.stats();
+		REQUIRE(48 == stats.num_states);
+		REQUIRE(47 == stats.num_transitions);
+		REQUIRE(5 == stats.num_keywords);
+		REQUIRE(5 == stats.num_emits);
+		REQUIRE(39 == stats.states_by_depth.size());
+		REQUIRE(1 == stats.states_by_depth[0]);
+		REQUIRE(3 == stats.states_by_depth[1]);
+		REQUIRE(4 == stats.states_by_depth[2]);
+		REQUIRE(4 == stats.fan_out.size());
+		REQUIRE(4 == stats.fan_out[0]);
+		REQUIRE(42 == stats.fan_out[1]);
+		REQUIRE(1 == stats.fan_out[2]);
+		REQUIRE(1 == stats.fan_out[3]);
+		REQUIRE(0 < stats.keyword_bytes);
+		REQUIRE(stats.total_bytes() > stats.num_states * sizeof(ac::state<char>));
+
+		t.build();
+		REQUIRE(6 == t.stats().num_emits);
+	}
+	SECTION("stats count the arena's reserve") {
+		// a tree node carries its colour and three links ahead of the value
+		const size_t transition = 4 * sizeof(void*) + sizeof(ac::state<char>::transition_type);
+
+		// a bulk insert reserves exactly its states, and a transition node for
+		// each below the root, whose own transitions come from the heap
+		ac::trie bulk;
+		const std::vector<std::string> keywords { "he", "hers", "his" };
+		bulk.insert(keywords.begin(), keywords.end());
+		auto stats = bulk.stats();
+		REQUIRE(7 == stats.num_states);
+		REQUIRE(transition == stats.reserved_bytes);
+
+		// an incremental insert takes a first block of 16 states
+		ac::trie one;
+		one.insert("a");
+		stats = one.stats();
+		REQUIRE(15 * sizeof(ac::state<char>) + 16 * transition == stats.reserved_bytes);
+		REQUIRE(stats.total_bytes() == stats.state_bytes + stats.transition_bytes + stats.emit_bytes
+			+ stats.keyword_bytes + stats.failure_bytes + stats.reserved_bytes);
+	}
+	SECTION("policy matcher") {
+		namespace policy = ac::policy;
+		const std::string text = "Hot chocolate, SHE said; hers and his were hotter";
+		const auto flatten = [](const ac::trie::emit_collection& emits) {
+			std::vector<std::pair<size_t, size_t>> spans;
+			for (const auto& e : emits) {
+				spans.push_back(std::make_pair(e.get_start(), e.get_end()));
+			}
+			return spans;
+		};
+
+		ac::trie t;
+		t.case_insensitive().remove_overlaps().only_whole_words();
+		t.insert("hot");
+		t.insert("hot chocolate");
+		t.insert("she");
+		t.insert("he");
+		t.insert("hers");
+		t.insert("his");
+		auto m = t.matcher<policy::fold_case, policy::whole_words, policy::non_overlapping>();
+		REQUIRE(flatten(t.parse_text(text)) == flatten(m.parse_text(text)));
+		REQUIRE(4 == m.count_matches(text));
+		REQUIRE(t.count_matches(text) == m.count_matches(text));
+		REQUIRE(m.find_matches(text).size() == 4);
+		REQUIRE(m.contains_any(text));
+		REQUIRE_FALSE(m.contains_any("hotter shelves"));
+
+		ac::trie u;
+		u.insert("he");
+		u.insert("hers");
+		auto overlapping = u.matcher<policy::exact_case, policy::any_boundary, policy::overlapping>();
+		REQUIRE(u.count_matches("ushers") == overlapping.count_matches("ushers"));
+		REQUIRE(2 == overlapping.count_matches("ushers"));
+		REQUIRE(1 == overlapping.count_matches("USHERS he"));
+
+		ac::trie w;
+		w.utf8().case_insensitive();
+		w.insert("grüße");
+		auto utf8 = w.matcher<policy::fold_case, policy::any_boundary, policy::overlapping, policy::utf8>();
+		auto emits = utf8.parse_text("viele GRÜSSE, viele GRÜßE");
+		REQUIRE(1 == emits.size());
+		REQUIRE(20 == emits[0].get_code_point_start());
+		REQUIRE(24 == emits[0].get_code_point_end());
+		REQUIRE(flatten(w.parse_text("viele GRÜSSE, viele GRÜßE")) == flatten(emits));
+	}
+	SECTION("policy matcher must agree with the trie") {
+		namespace policy = ac::policy;
+		ac::trie t;
+		t.case_insensitive();
+		t.insert("she");
+		REQUIRE_THROWS_AS((t.matcher<policy::exact_case, policy::any_boundary, policy::overlapping>()), std::logic_error);
+		REQUIRE_THROWS_AS((t.matcher<policy::fold_case, policy::any_boundary, policy::overlapping, policy::utf8>()), std::logic_error);
+		REQUIRE_NOTHROW((t.matcher<policy::fold_case, policy::whole_words, policy::non_overlapping>()));
+
+		ac::trie u;
+		u.utf8();
+		u.insert("she");
+		REQUIRE_THROWS_AS((u.matcher<policy::fold_case, policy::any_boundary, policy::overlapping, policy::utf8>()), std::logic_error);
+		REQUIRE_THROWS_AS((u.matcher<policy::exact_case, policy::any_boundary, policy::overlapping>()), std::logic_error);
+		REQUIRE_NOTHROW((u.matcher<policy::exact_case, policy::any_boundary, policy::overlapping, policy::utf8>()));
+	}
 	SECTION("segault with incremental parsing: github issue #7") {
 		ac::trie t;
 